@@ -0,0 +1,217 @@
+#include "BeamSolver.h"
+#include "StatePlanner.h"
+#include "Deadline.h"
+#include "DangerMap.h"
+#include <unistd.h>
+
+
+BeamSolver::BeamSolver(Field & amine)
+{
+	this->mine = amine;
+	width = BEAM_WIDTH;
+	threadsNum = BEAM_THREADS;
+	expanded = 0;
+}
+
+BeamSolver::~BeamSolver(void)
+{
+	ReleaseStates(beam);
+}
+
+void BeamSolver::SetWidth(size_t awidth)
+{
+	width = awidth > 0 ? awidth : 1;
+}
+
+void BeamSolver::SetThreads(int threads)
+{
+	threadsNum = threads;
+}
+
+const vector<_Command> & BeamSolver::GetTrace()
+{
+	return this->trace;
+}
+
+size_t BeamSolver::GetExpandedNodes()
+{
+	return this->expanded;
+}
+
+// Description: Ranks the children of every level and keeps the best ones until the robot escapes,
+// every state dies or the game lasts as many moves as the map has cells
+//
+// States are freed by this thread but made by the workers, so tiles aren't pooled here: other
+// threads could never take them.
+void BeamSolver::Solve()
+{
+	int threads = threadsNum;
+	if (threads <= 0) threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads <= 0) threads = 1;
+
+	State start;
+	start.parent = -1;
+	start.command = WAIT;
+	start.field = new Field(mine);
+	start.score = 0;
+	start.lambdas = 0;
+	start.escaped = false;
+	start.value = 0;
+	beam.push_back(start);
+
+	levels.assign(1, vector<Step>(1));
+	levels[0][0].parent = -1;
+	levels[0][0].command = WAIT;
+	seen.Clear();
+	seen.Update(mine.GetHash(), 0, 0);
+
+	// Aborting at once is the worst game
+	int bestScore = MOVE_COST, bestLevel = 0, bestIndex = 0;
+	bool bestEscaped = false;
+	int maxMoves = mine.GetWidth() * mine.GetHeight();
+
+	for (int level = 1; level <= maxMoves && !beam.empty() && !Deadline::Expired(); level++) {
+		// Every thread takes its share of the beam
+		int workersNum = min(threads, (int) beam.size());
+		vector<Worker> workers(workersNum);
+		vector<pthread_t> handles(workersNum);
+		for (int i = 0; i < workersNum; i++) {
+			workers[i].solver = this;
+			workers[i].first = beam.size() * i / workersNum;
+			workers[i].last = beam.size() * (i + 1) / workersNum;
+		}
+		for (int i = 1; i < workersNum; i++)
+			pthread_create(&handles[i], NULL, Expand, &workers[i]);
+		ExpandStates(workers[0]);
+		for (int i = 1; i < workersNum; i++)
+			pthread_join(handles[i], NULL);
+		expanded += beam.size();
+
+		// The best children which weren't kept before are kept; dropped ones may come back later
+		vector<State> children;
+		for (int i = 0; i < workersNum; i++)
+			children.insert(children.end(), workers[i].children.begin(), workers[i].children.end());
+		sort(children.begin(), children.end(), RankStates);
+
+		size_t kept = 0;
+		for (size_t i = 0; i < children.size(); i++) {
+			if (kept < width && seen.Update(children[i].field->GetHash(), level, 0)) children[kept++] = children[i];
+			else delete children[i].field;
+		}
+		children.resize(kept);
+
+		ReleaseStates(beam);
+		beam.swap(children);
+
+		levels.push_back(vector<Step>(beam.size()));
+		bool escaped = false;
+		for (size_t i = 0; i < beam.size(); i++) {
+			levels[level][i].parent = beam[i].parent;
+			levels[level][i].command = beam[i].command;
+
+			// An escape gives the game's score, another state can be aborted
+			int score = beam[i].escaped ? beam[i].score : beam[i].score + MOVE_COST + beam[i].lambdas * ABORT_COST;
+			if (score > bestScore) {
+				bestScore = score;
+				bestLevel = level;
+				bestIndex = i;
+				bestEscaped = beam[i].escaped;
+			}
+			escaped = escaped || beam[i].escaped;
+		}
+
+		// Games escaping later collect the same lambdas in more moves
+		if (escaped) break;
+	}
+
+	BuildTrace(bestLevel, bestIndex, bestEscaped);
+	ReleaseStates(beam);
+	levels.clear();
+}
+
+void * BeamSolver::Expand(void * worker)
+{
+	Worker * range = (Worker *) worker;
+	range->solver->ExpandStates(*range);
+	return NULL;
+}
+
+// Description: Makes every command on copies of the states of the range; only the Fields of
+// the range and their copies are touched, so ranges are expanded in parallel
+void BeamSolver::ExpandStates(Worker & worker)
+{
+	FieldArena arena;	// tiles of the copies made by the thread
+
+	const _Command commands[] = { UP, LEFT, RIGHT, DOWN, WAIT };
+	const int commandsNum = 5;
+
+	for (size_t i = worker.first; i < worker.last && !Deadline::Expired(); i++) {
+		State & state = beam[i];
+		if (state.escaped) continue;
+
+		for (int k = 0; k < commandsNum; k++) {
+			if (DangerMap::IsLethalMove(*state.field, commands[k])) continue;
+
+			State child;
+			child.parent = i;
+			child.command = commands[k];
+			child.field = new Field(*state.field);
+			if (!StatePlanner::MoveRobot(*child.field, commands[k])) {
+				delete child.field;
+				continue;
+			}
+
+			child.lambdas = state.lambdas + (int) (state.field->GetLambdasNum() - child.field->GetLambdasNum());
+			child.score = state.score + MOVE_COST + (child.lambdas - state.lambdas) * LAMBDA_COST;
+			child.escaped = child.field->GetRobot() == child.field->GetLift();
+			if (child.escaped) child.score += child.lambdas * LIFT_COST;
+			child.value = Evaluate(child);
+			worker.children.push_back(child);
+		}
+	}
+}
+
+// Description: Returns the score an abort would give less the distance to the nearest lambda
+// or to the opened lift; escaped states get the game's score
+int BeamSolver::Evaluate(State & state)
+{
+	if (state.escaped) return state.score;
+
+	Field * field = state.field;
+	IntPair robot = field->GetRobot();
+	int distance = 0;
+	if (field->GetLambdasNum() == 0) {
+		distance = abs(robot.first - field->GetLift().first) + abs(robot.second - field->GetLift().second);
+	} else {
+		const vector<IntPair> & lambdas = field->GetLambdas();
+		distance = field->GetWidth() + field->GetHeight();
+		for (size_t i = 0; i < lambdas.size(); i++)
+			distance = min(distance, abs(robot.first - lambdas[i].first) + abs(robot.second - lambdas[i].second));
+	}
+	return state.score + state.lambdas * ABORT_COST - distance;
+}
+
+bool BeamSolver::RankStates(const State & state1, const State & state2)
+{
+	return state1.value > state2.value;
+}
+
+void BeamSolver::ReleaseStates(vector<State> & states)
+{
+	for (size_t i = 0; i < states.size(); i++)
+		delete states[i].field;
+	states.clear();
+}
+
+// Description: Collects the commands leading to the state backwards through the levels
+void BeamSolver::BuildTrace(int level, int index, bool escaped)
+{
+	trace.clear();
+	for (; level > 0; level--) {
+		trace.push_back(levels[level][index].command);
+		index = levels[level][index].parent;
+	}
+	reverse(trace.begin(), trace.end());
+
+	if (!escaped) trace.push_back(ABORT);
+}
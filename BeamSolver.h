@@ -0,0 +1,73 @@
+#pragma once
+
+#include "stdafx.h"
+#include "Field.h"
+#include "FieldArena.h"
+#include "TranspositionTable.h"
+#include <pthread.h>
+
+// Solver which plays all commands from the best game states level by level.
+// Every level holds at most the beam width of states after one more command. They are ranked by
+// the score of the game, the bonus for collected lambdas which an abort would give and the distance
+// to the nearest lambda or to the opened lift. Dead states and states kept on earlier levels are dropped.
+// The states of a level are expanded by several threads, every one of them making its own Field copies.
+// The best score over all levels wins: by escaping through the lift or by aborting.
+class BeamSolver
+{
+	// State of the beam and the command it was reached by from the state of the previous level
+	struct State
+	{
+		int parent;
+		_Command command;
+		Field * field;
+		int score;			// score of the game after the command
+		int lambdas;		// lambdas collected
+		bool escaped;
+		int value;			// rank of the state in the beam
+	};
+
+	// Range of the states expanded by one thread
+	struct Worker
+	{
+		BeamSolver * solver;
+		size_t first;
+		size_t last;
+		vector<State> children;
+	};
+
+	// Command of the state kept for building the trace
+	struct Step
+	{
+		int parent;
+		_Command command;
+	};
+
+	Field mine;
+	size_t width;			// states kept on every level
+	int threadsNum;
+	vector<_Command> trace;
+	size_t expanded;
+
+	vector<State> beam;
+	vector< vector<Step> > levels;
+	TranspositionTable seen;	// states kept on the levels, the level is the cost
+
+public:
+	BeamSolver(Field & amine);
+	~BeamSolver(void);
+
+	void SetWidth(size_t awidth);
+	void SetThreads(int threads);	// 0 uses all processors
+	void Solve();
+
+	const vector<_Command> & GetTrace();	// commands of the best game, ABORT is added if the lift isn't reached
+	size_t GetExpandedNodes();
+
+private:
+	static void * Expand(void * worker);
+	void ExpandStates(Worker & worker);
+	int Evaluate(State & state);
+	static bool RankStates(const State & state1, const State & state2);	// higher value first
+	void ReleaseStates(vector<State> & states);
+	void BuildTrace(int level, int index, bool escaped);
+};
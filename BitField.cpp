@@ -0,0 +1,287 @@
+#include "BitField.h"
+
+
+BitField::BitField(size_t awidth, size_t aheight)
+{
+	width = awidth;
+	height = aheight;
+	words = (width + BITS_PER_WORD - 1) / BITS_PER_WORD;
+
+	bands.resize((height + FIELD_TILE_ROWS - 1) / FIELD_TILE_ROWS);
+	for (size_t i = 0; i < bands.size(); i++) {
+		bands[i] = new PlaneBand;
+		bands[i]->refs = 1;
+		bands[i]->words = new BitWord [PLANES * FIELD_TILE_ROWS * words];
+		memset(bands[i]->words, 0, PLANES * FIELD_TILE_ROWS * words * sizeof(BitWord));
+	}
+
+	robot = IntPair(-1, -1);
+	leaving.assign(words, 0);
+	arriving.assign(words, 0);
+	landing.assign(words, 0);
+}
+
+// Bands are shared until one of the copies writes into them
+BitField::BitField(const BitField & field)
+{
+	width = field.width;
+	height = field.height;
+	words = field.words;
+	bands = field.bands;
+	others = field.others;
+	robot = field.robot;
+	for (size_t i = 0; i < bands.size(); i++)
+		__sync_fetch_and_add(&bands[i]->refs, 1);
+	leaving.assign(words, 0);
+	arriving.assign(words, 0);
+	landing.assign(words, 0);
+}
+
+BitField::~BitField(void)
+{
+	ReleaseBands();
+}
+
+BitField & BitField::operator = (const BitField & field)
+{
+	if (this == &field) return *this;
+
+	for (size_t i = 0; i < field.bands.size(); i++)
+		__sync_fetch_and_add(&field.bands[i]->refs, 1);
+	ReleaseBands();
+	width = field.width;
+	height = field.height;
+	words = field.words;
+	bands = field.bands;
+	others = field.others;
+	robot = field.robot;
+	leaving.assign(words, 0);
+	arriving.assign(words, 0);
+	landing.assign(words, 0);
+	return *this;
+}
+
+// Description: Returns row of the plane ready for writing; the band is cloned first if other copies share it
+BitWord * BitField::MutableRow(int plane, size_t x)
+{
+	PlaneBand *& band = bands[x / FIELD_TILE_ROWS];
+	if (__sync_fetch_and_add(&band->refs, 0) > 1) {
+		PlaneBand * copy = new PlaneBand;
+		copy->refs = 1;
+		copy->words = new BitWord [PLANES * FIELD_TILE_ROWS * words];
+		memcpy(copy->words, band->words, PLANES * FIELD_TILE_ROWS * words * sizeof(BitWord));
+		if (__sync_sub_and_fetch(&band->refs, 1) == 0) {
+			delete [] band->words;
+			delete band;
+		}
+		band = copy;
+	}
+	return band->words + (plane * FIELD_TILE_ROWS + x % FIELD_TILE_ROWS) * words;
+}
+
+void BitField::ReleaseBands()
+{
+	for (size_t i = 0; i < bands.size(); i++) {
+		if (__sync_sub_and_fetch(&bands[i]->refs, 1) == 0) {
+			delete [] bands[i]->words;
+			delete bands[i];
+		}
+	}
+	bands.clear();
+}
+
+// Description: Decodes the object in the cell from the planes
+_MineObject BitField::GetObject(size_t x, size_t y)
+{
+	if (x >= height || y >= width) return '\0';
+
+	if (TestBit(ROCK_PLANE, x, y)) return STONE;
+	if (TestBit(EMPTY_PLANE, x, y)) return EMPTY;
+	if (TestBit(EARTH_PLANE, x, y)) return EARTH;
+	if (TestBit(LAMBDA_PLANE, x, y)) return LAMBDA;
+	if (TestBit(WALL_PLANE, x, y)) return WALL;
+
+	for (size_t i = 0; i < others.size(); i++)
+		if (others[i].first == IntPair(x, y)) return others[i].second;
+	return '\0';
+}
+
+void BitField::SetObject(size_t x, size_t y, _MineObject OBJECT)
+{
+	if (x >= height || y >= width) return;
+
+	size_t w = y / BITS_PER_WORD;
+	BitWord bit = 1ULL << (y % BITS_PER_WORD);
+
+	for (int plane = 0; plane < PLANES; plane++) {
+		if (Row(plane, x)[w] & bit) MutableRow(plane, x)[w] &= ~bit;
+	}
+	for (size_t i = 0; i < others.size(); i++) {
+		if (others[i].first == IntPair(x, y)) {
+			others[i] = others.back();
+			others.pop_back();
+			break;
+		}
+	}
+	if (robot == IntPair(x, y)) robot = IntPair(-1, -1);
+
+	switch (OBJECT) {
+	case STONE:
+		MutableRow(ROCK_PLANE, x)[w] |= bit;
+		break;
+	case EMPTY:
+		MutableRow(EMPTY_PLANE, x)[w] |= bit;
+		break;
+	case EARTH:
+		MutableRow(EARTH_PLANE, x)[w] |= bit;
+		break;
+	case LAMBDA:
+		MutableRow(LAMBDA_PLANE, x)[w] |= bit;
+		break;
+	case WALL:
+		MutableRow(WALL_PLANE, x)[w] |= bit;
+		break;
+	default:
+		others.push_back(make_pair(IntPair(x, y), OBJECT));
+		if (OBJECT == ROBOT) robot = IntPair(x, y);
+		break;
+	}
+}
+
+// Description: Applies the rock rules of Field::UpdateMap to all rows at once
+//
+// For every row i the rules are evaluated for 64 cells at a time. Neighbours (i; j+1) and (i; j-1)
+// are obtained by shifting the row by one bit. All rules read the old planes: row i is read only by
+// the rules of rows i - 1 and i, so its moves are applied right after its own rules, together with
+// the rocks arriving from row i - 1. The moves are kept in three scratch rows, only rows with moves
+// are written and cleared, so the other bands stay shared.
+bool BitField::UpdateMap(vector<IntPair> & freed, vector<IntPair> & filled)
+{
+	bool robotIsDead = false;
+	if (height < 3 || width < 3) return robotIsDead;
+
+	BitWord * from = &leaving[0];		// rocks leaving the cells of row i
+	BitWord * to = &arriving[0];		// rocks arriving to the cells of row i
+	BitWord * below = &landing[0];		// rocks arriving to the cells of row i + 1
+	bool arrives = false;
+
+	for (size_t i = 1; i < height; i++) {
+		bool leaves = false, lands = false;
+		if (i < height - 1) {
+			const BitWord * R = Row(ROCK_PLANE, i);
+			const BitWord * E = Row(EMPTY_PLANE, i);
+			const BitWord * Rb = Row(ROCK_PLANE, i + 1);
+			const BitWord * Eb = Row(EMPTY_PLANE, i + 1);
+			const BitWord * Lb = Row(LAMBDA_PLANE, i + 1);
+
+			for (size_t w = 0; w < words; w++) {
+				BitWord r = R[w] & InteriorMask(w);
+				if (!r) continue;
+
+				// Rock falls down if the cell below is empty
+				BitWord fall = r & Eb[w];
+				BitWord stay = r & ~Eb[w];
+				// Cells to the right and to the left of the rock and of the cell below are empty
+				BitWord rightIsFree = ShiftToLower(E, w) & ShiftToLower(Eb, w);
+				BitWord leftIsFree = ShiftToUpper(E, w) & ShiftToUpper(Eb, w);
+				// Rock on a rock or on a lambda slides to the right, rock on a rock slides to the left otherwise
+				BitWord toRight = stay & (Rb[w] | Lb[w]) & rightIsFree;
+				BitWord toLeft = stay & Rb[w] & ~rightIsFree & leftIsFree;
+
+				BitWord move = fall | toRight | toLeft;
+				if (!move) continue;
+				leaves = lands = true;
+				from[w] |= move;
+				below[w] |= fall;
+				below[w] |= toRight << 1;
+				if (w + 1 < words) below[w + 1] |= toRight >> (BITS_PER_WORD - 1);
+				below[w] |= toLeft >> 1;
+				if (w > 0) below[w - 1] |= toLeft << (BITS_PER_WORD - 1);
+			}
+		}
+
+		if (leaves || arrives) {
+			// A rock which arrives right above the robot kills him
+			if (arrives && robot.first > 0 && (size_t) robot.first - 1 == i
+				&& ((to[robot.second / BITS_PER_WORD] >> (robot.second % BITS_PER_WORD)) & 1))
+				robotIsDead = true;
+
+			BitWord * rocks = MutableRow(ROCK_PLANE, i);
+			BitWord * empty = MutableRow(EMPTY_PLANE, i);
+			for (size_t w = 0; w < words; w++) {
+				rocks[w] = (rocks[w] & ~from[w]) | to[w];
+				empty[w] = (empty[w] | from[w]) & ~to[w];
+			}
+			CollectCells(from, i, freed);
+			CollectCells(to, i, filled);
+			memset(from, 0, words * sizeof(BitWord));
+			memset(to, 0, words * sizeof(BitWord));
+		}
+
+		swap(to, below);
+		arrives = lands;
+	}
+
+	return robotIsDead;
+}
+
+BitWord BitField::ShiftToLower(const BitWord * row, size_t w)
+{
+	BitWord result = row[w] >> 1;
+	if (w + 1 < words) result |= row[w + 1] << (BITS_PER_WORD - 1);
+	return result;
+}
+
+BitWord BitField::ShiftToUpper(const BitWord * row, size_t w)
+{
+	BitWord result = row[w] << 1;
+	if (w > 0) result |= row[w - 1] >> (BITS_PER_WORD - 1);
+	return result;
+}
+
+// Description: Counts the table of other objects and the bands the origin doesn't share
+size_t BitField::GetBytesApartFrom(BitField * origin)
+{
+	size_t bytes = sizeof(BitField) + bands.size() * sizeof(PlaneBand *) + others.size() * sizeof(others[0]);
+	for (size_t i = 0; i < bands.size(); i++) {
+		if (!origin || i >= origin->bands.size() || origin->bands[i] != bands[i])
+			bytes += sizeof(PlaneBand) + PLANES * FIELD_TILE_ROWS * words * sizeof(BitWord);
+	}
+	return bytes;
+}
+
+// Description: Returns mask of the columns 1..width-2 of the word, rules are not applied to the border
+BitWord BitField::InteriorMask(size_t w)
+{
+	size_t first = w * BITS_PER_WORD;
+	size_t last = width - 1;	// first column after the interior
+	if (last <= first) return 0;
+
+	BitWord mask = ~0ULL;
+	if (first == 0) mask &= ~1ULL;
+	if (last - first < BITS_PER_WORD) mask &= (1ULL << (last - first)) - 1;
+	return mask;
+}
+
+bool BitField::TestBit(int plane, size_t x, size_t y)
+{
+	return (Row(plane, x)[y / BITS_PER_WORD] >> (y % BITS_PER_WORD)) & 1;
+}
+
+// Description: Appends coordinates of all set bits of the row x
+void BitField::CollectCells(const BitWord * row, size_t x, vector<IntPair> & cells)
+{
+	for (size_t w = 0; w < words; w++) {
+		BitWord word = row[w];
+		while (word) {
+#ifdef __GNUC__
+			size_t bit = __builtin_ctzll(word);
+#else
+			size_t bit = 0;
+			while (!((word >> bit) & 1)) bit++;
+#endif
+			cells.push_back(IntPair(x, w * BITS_PER_WORD + bit));
+			word &= word - 1;
+		}
+	}
+}
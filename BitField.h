@@ -0,0 +1,63 @@
+#pragma once
+
+#include "stdafx.h"
+
+typedef unsigned long long BitWord;
+
+#define BITS_PER_WORD 64
+
+// Bit-plane representation of the mine: every kind of object has its own bitset
+// with one bit per cell and 64 cells per word, rows are padded to whole words.
+// The planes are cut into bands of FIELD_TILE_ROWS rows shared by copies like FieldTile,
+// so copying a BitField only retains its bands; a band is cloned by the copy which writes into it.
+// Robot, lift and other rare objects are kept in a small table of their cells.
+class BitField
+{
+	enum { ROCK_PLANE, EMPTY_PLANE, EARTH_PLANE, LAMBDA_PLANE, WALL_PLANE, PLANES };
+
+	// Rows of all planes in one band
+	struct PlaneBand
+	{
+		int refs;
+		BitWord * words;	// PLANES planes of FIELD_TILE_ROWS rows each
+	};
+
+	size_t width;
+	size_t height;
+	size_t words;		// words per row
+
+	vector<PlaneBand *> bands;
+	vector< pair<IntPair, _MineObject> > others;	// cells with objects which have no plane
+	IntPair robot;
+	vector<BitWord> leaving, arriving, landing;	// scratch rows of UpdateMap, zero between updates
+
+public:
+	BitField(size_t awidth, size_t aheight);
+	BitField(const BitField & field);
+	~BitField(void);
+
+	_MineObject GetObject(size_t x, size_t y);
+	void SetObject(size_t x, size_t y, _MineObject OBJECT);
+
+	// Applies the rock rules to all rows with word operations.
+	// Freed and filled cells are appended to the vectors, returns true if a rock falls on the robot.
+	bool UpdateMap(vector<IntPair> & freed, vector<IntPair> & filled);
+
+	size_t GetBytesApartFrom(BitField * origin);	// estimates memory not shared with the origin
+
+	BitField & operator = (const BitField & field);
+
+private:
+	const BitWord * Row(int plane, size_t x)
+	{
+		return bands[x / FIELD_TILE_ROWS]->words + (plane * FIELD_TILE_ROWS + x % FIELD_TILE_ROWS) * words;
+	}
+	BitWord * MutableRow(int plane, size_t x);	// makes the band private before writing into it
+	void ReleaseBands();
+
+	BitWord ShiftToLower(const BitWord * row, size_t w);	// bit j gets the value of bit j + 1
+	BitWord ShiftToUpper(const BitWord * row, size_t w);	// bit j gets the value of bit j - 1
+	BitWord InteriorMask(size_t w);
+	bool TestBit(int plane, size_t x, size_t y);
+	void CollectCells(const BitWord * row, size_t x, vector<IntPair> & cells);
+};
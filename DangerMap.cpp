@@ -0,0 +1,66 @@
+#include "DangerMap.h"
+
+
+// Description: Finds out whether a rock lands above the robot on the update after the command.
+// The rules are checked on the map as the command leaves it: the robot's old cell is empty, the robot
+// is in its new cell and a pushed rock is in the next one. A rock lands in the empty cell above the
+// robot if it falls from the cell above that, or slides from the upper left or upper right cell.
+// Returns: false also if the robot can't make the command
+bool DangerMap::IsLethalMove(Field & field, _Command command)
+{
+	IntPair robot = field.GetRobot();
+	int x = robot.first, y = robot.second;
+	switch (command) {
+	case RIGHT:
+		y++;
+		break;
+	case LEFT:
+		y--;
+		break;
+	case UP:
+		x--;
+		break;
+	case DOWN:
+		x++;
+		break;
+	}
+
+	// Cells changed by the command, the others are read from the field
+	IntPair cells[3];
+	_MineObject objects[3];
+	int changed = 0;
+	if (command != WAIT) {
+		if (!field.isWalkable(x, y)) return false;
+		if (field.GetObject(x, y) == STONE) {
+			cells[changed] = IntPair(x, 2 * y - robot.second);
+			objects[changed++] = STONE;
+		}
+		cells[changed] = robot;
+		objects[changed++] = EMPTY;
+		cells[changed] = IntPair(x, y);
+		objects[changed++] = ROBOT;
+	}
+
+	_MineObject map[2][5];		// rows x - 2 and x - 1, columns y - 2..y + 2
+	for (int i = 0; i < 2; i++) {
+		for (int j = 0; j < 5; j++) {
+			IntPair cell(x - 2 + i, y - 2 + j);
+			map[i][j] = field.GetObject(cell.first, cell.second);	// '\0' outside of the map
+			for (int k = 0; k < changed; k++) {
+				if (cells[k] == cell) map[i][j] = objects[k];
+			}
+		}
+	}
+
+	// The cell above the robot is map[1][2], rocks may come from map[0][1..3]
+	if (map[1][2] != EMPTY) return false;
+	if (map[0][2] == STONE) return true;
+	// The rock in the upper left cell slides right over a rock or a lambda
+	if (map[0][1] == STONE && (map[1][1] == STONE || map[1][1] == LAMBDA) && map[0][2] == EMPTY)
+		return true;
+	// The rock in the upper right cell slides left over a rock unless it can slide right
+	if (map[0][3] == STONE && map[1][3] == STONE && map[0][2] == EMPTY
+		&& !(map[0][4] == EMPTY && map[1][4] == EMPTY))
+		return true;
+	return false;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "stdafx.h"
+#include "Field.h"
+
+// Cells where the robot dies.
+// IsLethalMove tells in O(1) whether the next command kills the robot: only the cells around the one
+// above the robot decide whether a rock lands there on the update after the command.
+class DangerMap
+{
+public:
+	static bool IsLethalMove(Field & field, _Command command);	// checks whether the robot dies on the update after the command
+};
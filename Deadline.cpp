@@ -0,0 +1,40 @@
+#include "Deadline.h"
+
+volatile sig_atomic_t Deadline::expired = 0;
+bool Deadline::limited = false;
+timespec Deadline::end;
+
+void Deadline::SetTimeLimit(double seconds)
+{
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	long long nanoseconds = end.tv_nsec + (long long) (seconds * 1e9);
+	end.tv_sec += (time_t) (nanoseconds / 1000000000);
+	end.tv_nsec = (long) (nanoseconds % 1000000000);
+	limited = true;
+	expired = 0;
+}
+
+void Deadline::Interrupt()
+{
+	expired = 1;
+}
+
+bool Deadline::IsLimited()
+{
+	return limited;
+}
+
+// Description: Checks whether the budget is over; the clock is read only when a time limit is set
+bool Deadline::Expired()
+{
+	if (expired) return true;
+	if (!limited) return false;
+
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (now.tv_sec > end.tv_sec || (now.tv_sec == end.tv_sec && now.tv_nsec >= end.tv_nsec)) {
+		expired = 1;
+		return true;
+	}
+	return false;
+}
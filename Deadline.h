@@ -0,0 +1,23 @@
+#pragma once
+
+#include "stdafx.h"
+#include <signal.h>
+#include <time.h>
+
+// Budget of time shared by every phase of solving.
+// Phases poll Expired in their loops and stop with the best result they have, so the game can
+// still print a trace when the time limit passes or the user interrupts the program.
+// Interrupt only writes a flag, so it may be called from a signal handler; Expired may be called
+// from any thread.
+class Deadline
+{
+	static volatile sig_atomic_t expired;
+	static bool limited;
+	static timespec end;
+
+public:
+	static void SetTimeLimit(double seconds);	// the budget ends the given time from now
+	static void Interrupt();					// ends the budget at once
+	static bool IsLimited();					// checks whether a time limit is set
+	static bool Expired();
+};
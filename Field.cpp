@@ -1,103 +1,403 @@
 #include "Field.h"
+#include "FieldJournal.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FIELD_USE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Codes of the objects used by the rock rules in packed storage, see Field::cellObjects
+#define EMPTY_CODE 0
+#define WALL_CODE 1
+#define STONE_CODE 2
+#define LAMBDA_CODE 4
+
+// Objects of the first codes are fixed and get their codes before main. Codes of other objects are
+// given only by PackRow and SetStorage when they are met first, so searches only read the tables.
+_MineObject Field::cellObjects[16] = { EMPTY, WALL, STONE, EARTH, LAMBDA, ROBOT, CLOSED_LIFT, OPENED_LIFT };
+int Field::cellObjectsNum = 8;
+unsigned char Field::cellCodes[256];
+const bool Field::fixedCodes = Field::CodeFixedObjects();
 
 Field::Field(void)
 {
 	mapWidth = -1;
 	mapHeight = -1;
-	map = NULL;
+	mapStride = 0;
+	rowBytes = 0;
+	packed = (FIELD_DEFAULT_STORAGE == PACKED_STORAGE);
+	bits = NULL;
 	liftIsOpen = false;
 	robotIsDead = false;
+	hash = 0;
+	journal = NULL;
+	analysis = NULL;
 }
 
 Field::Field(const Field & field)
 {
 	mapWidth = field.mapWidth;
 	mapHeight = field.mapHeight;
+	mapStride = field.mapStride;
+	rowBytes = field.rowBytes;
+	packed = field.packed;
 	robot = field.robot;
 	lambdas = field.lambdas;
 	lift = field.lift;
 	liftIsOpen = field.liftIsOpen;
+	robotIsDead = field.robotIsDead;
+	hash = field.hash;
+	changedCells = field.changedCells;
+	bits = field.bits ? new BitField(*field.bits) : NULL;
+	journal = NULL;
+	analysis = field.analysis;
+	if (analysis) analysis->Retain();
 
-	map = new _MineObject * [mapHeight];
-	for (size_t i = 0; i < mapHeight; i++) {
-		map[i] = new _MineObject [mapWidth];
-		for (size_t j = 0; j < mapWidth; j++) {
-			map[i][j] = field.map[i][j];
-		}
-	}
+	// Tiles are shared until one of the Fields writes into them
+	tiles = field.tiles;
+	for (size_t i = 0; i < tiles.size(); i++)
+		tiles[i]->Retain();
+}
+
+#ifdef HAS_MOVE_SEMANTICS
+Field::Field(Field && field)
+{
+	mapWidth = -1;
+	mapHeight = -1;
+	mapStride = 0;
+	rowBytes = 0;
+	packed = field.packed;
+	bits = NULL;
+	liftIsOpen = false;
+	robotIsDead = false;
+	hash = 0;
+	journal = NULL;
+	analysis = NULL;
+
+	*this = std::move(field);
 }
+#endif
 
 Field::~Field(void)
 {
-	//if (map)
-	//	for (int i = 0; i < mapHeight; i++)
-	//		delete [] map[i];
+	FreeMap();
+	if (analysis) analysis->Release();
+	delete bits;
+	delete journal;
 }
 
-// Description: Loads map from file and fills Field's fields =)
+// Description: Allocates tiles for the map; all cells are filled with walls
+void Field::AllocateMap(size_t width, size_t height)
+{
+	mapStride = (width + FIELD_STRIDE_ALIGN - 1) / FIELD_STRIDE_ALIGN * FIELD_STRIDE_ALIGN;
+	if (mapStride == 0) mapStride = FIELD_STRIDE_ALIGN;
+	rowBytes = packed ? mapStride / 2 : mapStride;
+
+	// one more row guards reads below the bottom row
+	size_t count = (height + 1 + FIELD_TILE_ROWS - 1) / FIELD_TILE_ROWS;
+	tiles.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		tiles[i] = FieldTile::Create(FIELD_TILE_ROWS * rowBytes);
+		memset(tiles[i]->GetCells(), packed ? WALL_CODE * 0x11 : WALL, tiles[i]->GetSize());
+	}
+}
+
+void Field::FreeMap()
+{
+	for (size_t i = 0; i < tiles.size(); i++)
+		tiles[i]->Release();
+	tiles.clear();
+}
+
+// Description: Returns row ready for writing; the tile is cloned first if other Fields share it
+_MineObject * Field::MutableRow(size_t x)
+{
+	FieldTile *& tile = tiles[x / FIELD_TILE_ROWS];
+	if (tile->IsShared()) {
+		FieldTile * copy = tile->Clone();
+		tile->Release();
+		tile = copy;
+	}
+	return tile->GetCells() + (x % FIELD_TILE_ROWS) * rowBytes;
+}
+
+// Description: Writes the object into the row taken from MutableRow
+void Field::PutCell(_MineObject * row, size_t y, _MineObject OBJECT)
+{
+	if (packed) {
+		unsigned char shift = (y & 1) << 2;
+		row[y >> 1] = (row[y >> 1] & ~(0xF << shift)) | (EncodeObject(OBJECT) << shift);
+	} else {
+		row[y] = OBJECT;
+	}
+}
+
+// Description: Packs the text of the row, cells after its end up to the stride are empty
+// Returns: false if some object has no code
+bool Field::PackRow(_MineObject * row, const char * text, size_t length)
+{
+	for (size_t j = 0; j < length; j++) {
+		if (AddObjectCode(text[j]) == -1) return false;
+		PutCell(row, j, text[j]);
+	}
+	memset(row + (length + 1) / 2, EMPTY_CODE * 0x11, rowBytes - (length + 1) / 2);
+	if (length & 1) PutCell(row, length, EMPTY);
+	return true;
+}
+
+int Field::EncodeObject(_MineObject OBJECT)
+{
+	return cellCodes[(unsigned char) OBJECT] - 1;
+}
+
+// Description: Gives the next free code to the object if it has none
+// Returns: code of the object or -1 if all codes are taken
+int Field::AddObjectCode(_MineObject OBJECT)
+{
+	unsigned char & code = cellCodes[(unsigned char) OBJECT];
+	if (code == 0 && cellObjectsNum < 16) {
+		cellObjects[cellObjectsNum++] = OBJECT;
+		code = cellObjectsNum;
+	}
+	return code - 1;
+}
+
+bool Field::CodeFixedObjects()
+{
+	for (int i = 0; i < cellObjectsNum; i++)
+		cellCodes[(unsigned char) cellObjects[i]] = i + 1;
+	return true;
+}
+
+// Description: Loads map from stream and fills Field's fields =)
+// The stream is read once in blocks and the rows are parsed straight from the blocks, so pipes work
+// as well as files; only a row cut by the end of a block is put together first
 int Field::LoadMap(istream &sin)
 {
-	mapWidth = -1;
-	mapHeight = -1;
-	map = NULL;
+	LoadedRows rows;
+	string rest;
+	char block[FIELD_READ_BLOCK];
+
+	BeginMap();
+	while (sin.read(block, sizeof(block)) || sin.gcount() > 0) {
+		ParseRows(block, sin.gcount(), rest, rows);
+	}
+	AddRow(rest.data(), rest.size(), rows);
+	return EndMap(rows);
+}
+
+// Description: Loads map from file; regular files are mapped into memory and parsed in place
+// Returns: 0 if map is loaded, -1 if file can't be opened
+int Field::LoadMap(const char * fileName)
+{
+#ifdef FIELD_USE_MMAP
+	int fd = open(fileName, O_RDONLY);
+	if (fd == -1) return -1;
+
+	struct stat info;
+	if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+		size_t size = info.st_size;
+		void * data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) {
+			madvise(data, size, MADV_SEQUENTIAL);
+			int result = ParseMap((const char *) data, size);
+			munmap(data, size);
+			close(fd);
+			return result;
+		}
+	}
+	close(fd);
+#endif
+
+	// Pipes, empty files and systems without mmap are read as a stream
+	ifstream fin(fileName);
+	if (!fin.is_open()) return -1;
+	return LoadMap(fin);
+}
+
+// Description: Builds the map from the text in one pass over the rows
+// Rows are separated by '\n', the text after the last separator is a row too (as getline reads it).
+int Field::ParseMap(const char * data, size_t size)
+{
+	LoadedRows rows;
+	string rest;
+
+	BeginMap();
+	ParseRows(data, size, rest, rows);
+	AddRow(rest.data(), rest.size(), rows);
+	return EndMap(rows);
+}
+
+// Description: Adds the rows ended in the block. The rest holds the beginning of the row cut by the
+// end of the previous block, the text after the last separator is left in it.
+void Field::ParseRows(const char * data, size_t size, string & rest, LoadedRows & rows)
+{
+	if (size == 0) return;
+
+	const char * end = data + size;
+	const char * p = data;
+	for (const char * eol; (eol = (const char *) memchr(p, '\n', end - p)) != NULL; p = eol + 1) {
+		if (rest.empty()) {
+			AddRow(p, eol - p, rows);
+		} else {
+			rest.append(p, eol - p);
+			AddRow(rest.data(), rest.size(), rows);
+			rest.clear();
+		}
+	}
+	rest.append(p, end - p);
+}
+
+// Description: Makes the map empty before the rows are added
+void Field::BeginMap()
+{
+	if (journal) journal->RecordAssign(*this);
+
+	FreeMap();
+	mapWidth = 0;
+	mapHeight = 0;
+	mapStride = FIELD_STRIDE_ALIGN;
+	rowBytes = packed ? mapStride / 2 : mapStride;
 	liftIsOpen = false;
 	robotIsDead = false;
-	lambdas.clear();
+	changedCells.clear();
+	lambdas.Reset(0, 0);
+	hash = 0;
+}
 
-	vector<string> buf;
-	string str;
-	size_t width = 0;
+// Description: Appends the row to the map
+//
+// The text is copied straight into the tile, robot, lift, lambdas and rocks are found and the hash
+// is calculated while copying. Cells after the text are empty. The width of the map is known only
+// after the last row, so a longer row doubles the stride of the rows loaded before it.
+void Field::AddRow(const char * text, size_t length, LoadedRows & rows)
+{
+	if (length > mapStride) RestrideMap(max(mapStride * 2, length), packed);
+	if (length > mapWidth) mapWidth = length;
 
-	// Counting mine's dimension
-	while (!sin.eof()) {
-		getline(sin, str);
-		buf.push_back(str);
-		if (str.size() > width) width = str.size(); // remember the longest row
+	size_t i = mapHeight;
+	if (i / FIELD_TILE_ROWS == tiles.size())
+		tiles.push_back(FieldTile::Create(FIELD_TILE_ROWS * rowBytes));
+	_MineObject * row = MutableRow(i);
+
+	if (packed && !PackRow(row, text, length)) {
+		RestrideMap(mapStride, false);		// there are more kinds of objects than codes
+		row = MutableRow(i);
+	}
+	if (!packed) {
+		if (length > 0) memcpy(row, text, length);
+		memset(row + length, EMPTY, mapStride - length);
 	}
+	mapHeight++;
+	rows.lengths.push_back(length);
 
-	mapWidth = width;
-	mapHeight = buf.size();
-	sin.seekg(0, ios::beg);
+	for (size_t j = 0; j < length; j++) {
+		hash ^= CellKey(i, j, text[j]);
+		switch (text[j]) {
+		case STONE:					// every rock has to be checked on the first update
+			MarkChanged(i, j);
+			break;
+		case ROBOT:					// remembering robot coordinates
+			robot.first = i;
+			robot.second = j;
+			break;
+		case LAMBDA:				// lambdas are listed when the width of the map is known
+			rows.lambdas.push_back(IntPair(i, j));
+			break;
+		case CLOSED_LIFT:			// remembering closed lift coordinates
+			lift.first = i;
+			lift.second = j;
+			break;
+		case OPENED_LIFT:			// remembering open lift coordinates
+			lift.first = i;
+			lift.second = j;
+			liftIsOpen = true;
+			break;
+		}
+	}
+}
+
+// Description: Finishes the map after the last row: cuts the stride to the width, puts walls after
+// the width and into the guard row, and adds the lambdas and the empty cells of short rows to the hash
+int Field::EndMap(LoadedRows & rows)
+{
+	size_t stride = (mapWidth + FIELD_STRIDE_ALIGN - 1) / FIELD_STRIDE_ALIGN * FIELD_STRIDE_ALIGN;
+	if (stride != mapStride && stride != 0) RestrideMap(stride, packed);
+
+	// one more row guards reads below the bottom row
+	size_t count = (mapHeight + 1 + FIELD_TILE_ROWS - 1) / FIELD_TILE_ROWS;
+	while (tiles.size() < count)
+		tiles.push_back(FieldTile::Create(FIELD_TILE_ROWS * rowBytes));
+	for (size_t i = 0; i < count * FIELD_TILE_ROWS; i++) {
+		_MineObject * row = MutableRow(i);
+		for (size_t j = (i < mapHeight ? mapWidth : 0); j < mapStride; j++)
+			PutCell(row, j, WALL);
+	}
 
-	map = new char * [mapHeight];
 	for (size_t i = 0; i < mapHeight; i++) {
-		map[i] = new char [mapWidth];
-		for (size_t j = 0; j < mapWidth; j++) {
+		for (size_t j = rows.lengths[i]; j < mapWidth; j++)
+			hash ^= CellKey(i, j, EMPTY);
+	}
+	lambdas.Reset(mapHeight, mapWidth);
+	for (size_t k = 0; k < rows.lambdas.size(); k++)
+		lambdas.Add(rows.lambdas[k]);
 
-			// All rows shorter than map width are supplemented with whitespaces
-			if (j >= buf.at(i).size()) {
-				map[i][j] = EMPTY;
-				continue;
-			}
-			map[i][j] = buf.at(i)[j];
-
-			if (map[i][j] == ROBOT) {				// remembering robot coordinates
-				robot.first = i;
-				robot.second = j;
-			} else if (map[i][j] == LAMBDA)
-				lambdas.push_back(IntPair(i, j));		// filling lambdas's list
-			else if (map[i][j] == CLOSED_LIFT) {	// remembering closed lift coordinates
-				lift.first = i;
-				lift.second = j;
-			} else if (map[i][j] == OPENED_LIFT) {	// remembering open lift coordinates
-				lift.first = i;
-				lift.second = j;
-				liftIsOpen = true;
-			}
+	if (bits) BuildBitField();
+	if (analysis) analysis->Release();
+	analysis = new MapAnalysis(*this);
+	hash ^= RobotKey(robot.first, robot.second);
+	if (liftIsOpen) hash ^= LiftKey();
+
+	return 0;
+}
+
+// Description: Moves the rows loaded so far into tiles of the other stride or storage,
+// cells after the width are empty
+void Field::RestrideMap(size_t stride, bool pack)
+{
+	vector<FieldTile *> old;
+	old.swap(tiles);
+	size_t oldStride = mapStride;
+	size_t oldBytes = rowBytes;
+	bool wasPacked = packed;
+
+	mapStride = (stride + FIELD_STRIDE_ALIGN - 1) / FIELD_STRIDE_ALIGN * FIELD_STRIDE_ALIGN;
+	packed = pack;
+	rowBytes = packed ? mapStride / 2 : mapStride;
+	tiles.resize(old.size());
+	for (size_t k = 0; k < tiles.size(); k++) {
+		tiles[k] = FieldTile::Create(FIELD_TILE_ROWS * rowBytes);
+		memset(tiles[k]->GetCells(), packed ? EMPTY_CODE * 0x11 : EMPTY, tiles[k]->GetSize());
+	}
+
+	for (size_t i = 0; i < mapHeight; i++) {
+		const _MineObject * from = old[i / FIELD_TILE_ROWS]->GetCells() + (i % FIELD_TILE_ROWS) * oldBytes;
+		_MineObject * row = MutableRow(i);
+		if (!wasPacked && !packed) {
+			memcpy(row, from, mapWidth);
+			continue;
 		}
+		for (size_t j = 0; j < mapWidth; j++)
+			PutCell(row, j, wasPacked ? cellObjects[CellCode(from, j)] : from[j]);
 	}
+	for (size_t k = 0; k < old.size(); k++)
+		old[k]->Release();
 
-	return 0;
+	for (size_t k = 0; k < changedCells.size(); k++)
+		changedCells[k] = changedCells[k] / oldStride * mapStride + changedCells[k] % oldStride;
 }
 
 // Description: Prints map using the specified stream
 void Field::SaveMap(ostream &sout)
 {
+	vector<_MineObject> row(mapWidth + 1);
 	sout << endl;
 	for (size_t i = 0; i < mapHeight; i++) {
-		for (size_t j = 0; j < mapWidth; j++) {
-			sout << map[i][j];
-		}
+		GetRow(i, &row[0]);
+		sout.write(&row[0], mapWidth);
 		sout << endl;
 	}
 	sout << endl;
@@ -109,8 +409,8 @@ int Field::CheckMine()
 {
 	for (size_t i = 0; i < mapHeight; i++) {
 		for (size_t j = 0; j < mapWidth; j++) {
-			if (map[i][j] != EMPTY) {
-				if (map[i][j] != WALL && map[i][j] != CLOSED_LIFT) {
+			if (Cell(i, j) != EMPTY) {
+				if (Cell(i, j) != WALL && Cell(i, j) != CLOSED_LIFT) {
 					return -1;
 				} else break;
 			}
@@ -120,8 +420,8 @@ int Field::CheckMine()
 		}
 
 		for (size_t k = 0; k < mapWidth; k++) {
-			if (map[i][mapWidth - 1 - k] != EMPTY) {
-				if (map[i][mapWidth - 1 - k] != WALL && map[i][mapWidth - 1 - k] != CLOSED_LIFT) {
+			if (Cell(i, mapWidth - 1 - k) != EMPTY) {
+				if (Cell(i, mapWidth - 1 - k) != WALL && Cell(i, mapWidth - 1 - k) != CLOSED_LIFT) {
 					return -1;
 				} else break;
 			}
@@ -130,16 +430,16 @@ int Field::CheckMine()
 
 	for (size_t i = 0; i < mapHeight; i += mapHeight - 1) {
 		size_t index = 0;
-		while (map[i][index] == EMPTY) {
+		while (Cell(i, index) == EMPTY) {
 			index++;
 			if (index == mapWidth && (i != 0 && i != mapHeight - 1))
 				return -1;
 		}
 		for (size_t j = index; j < mapWidth; j++) {
-			if (map[i][j] != WALL && map[i][j] != CLOSED_LIFT) {
-				if (map[i][j] == EMPTY) {
+			if (Cell(i, j) != WALL && Cell(i, j) != CLOSED_LIFT) {
+				if (Cell(i, j) == EMPTY) {
 					while (j < mapWidth) {
-						if (map[i][j] != EMPTY)
+						if (Cell(i, j) != EMPTY)
 							return -1;
 						j++;
 					}
@@ -153,12 +453,12 @@ int Field::CheckMine()
 	int robot_num = 0, closed_lift_num = 0;
 	for (size_t i = 0; i < mapHeight; i++) {
 		for (size_t j = 0; j < mapWidth; j++) {
-			if (map[i][j] == ROBOT) {
+			if (Cell(i, j) == ROBOT) {
 				robot_num++;
-			} else if (map[i][j] == CLOSED_LIFT) {
+			} else if (Cell(i, j) == CLOSED_LIFT) {
 				closed_lift_num++;
-			} else if (map[i][j] != STONE && map[i][j] != WALL && map[i][j] != EARTH && 
-				map[i][j] != LAMBDA && map[i][j] != EMPTY) {
+			} else if (Cell(i, j) != STONE && Cell(i, j) != WALL && Cell(i, j) != EARTH && 
+				Cell(i, j) != LAMBDA && Cell(i, j) != EMPTY) {
 					return -1;
 			}
 		}
@@ -170,10 +470,244 @@ int Field::CheckMine()
 	return 0;
 }
 
+// Description: Selects representation used for rock updates
+void Field::SetBackend(int backend)
+{
+	if (backend == BITBOARD_BACKEND) {
+		if (!bits) BuildBitField();
+	} else {
+		delete bits;
+		bits = NULL;
+	}
+}
+
+int Field::GetBackend()
+{
+	return bits ? BITBOARD_BACKEND : GRID_BACKEND;
+}
+
+// Description: Rewrites the map into tiles of the other storage
+// Returns: 0 if storage is changed, -1 if the map has more kinds of objects than packed cells have codes
+int Field::SetStorage(int storage)
+{
+	bool pack = (storage == PACKED_STORAGE);
+	if (pack == packed) return 0;
+	if (tiles.empty()) {
+		packed = pack;
+		return 0;
+	}
+
+	vector<_MineObject> cells((mapHeight + 1) * mapWidth + 1);
+	for (size_t i = 0; i <= mapHeight; i++) {
+		GetRow(i, &cells[i * mapWidth]);
+		if (pack) {
+			for (size_t j = 0; j < mapWidth; j++)
+				if (AddObjectCode(cells[i * mapWidth + j]) == -1) return -1;
+		}
+	}
+
+	FreeMap();
+	packed = pack;
+	AllocateMap(mapWidth, mapHeight);
+	for (size_t i = 0; i <= mapHeight; i++) {
+		_MineObject * row = MutableRow(i);
+		for (size_t j = 0; j < mapWidth; j++)
+			PutCell(row, j, cells[i * mapWidth + j]);
+	}
+	return 0;
+}
+
+int Field::GetStorage()
+{
+	return packed ? PACKED_STORAGE : BYTE_STORAGE;
+}
+
+// Description: Checks whether bit planes describe the same mine as the map
+// Returns: 0 if they are the same or there are no bit planes, -1 otherwise
+int Field::CheckBitField()
+{
+	if (!bits) return 0;
+	for (size_t i = 0; i < mapHeight; i++) {
+		for (size_t j = 0; j < mapWidth; j++) {
+			if (bits->GetObject(i, j) != Cell(i, j))
+				return -1;
+		}
+	}
+	return 0;
+}
+
+void Field::BuildBitField()
+{
+	delete bits;
+	bits = new BitField(mapWidth, mapHeight);
+	for (size_t i = 0; i < mapHeight; i++) {
+		for (size_t j = 0; j < mapWidth; j++) {
+			bits->SetObject(i, j, Cell(i, j));
+		}
+	}
+}
+
+// Description: Returns 64-bit hash of the mine state (cells, robot position and lift state)
+//
+// The hash is the XOR of Zobrist keys of all cells, of the robot position and of the open lift,
+// it is updated on every change, so equal states have equal hashes without comparing the maps.
+_StateHash Field::GetHash()
+{
+	return this->hash;
+}
+
+// Description: Calculates the hash from scratch
+_StateHash Field::ComputeHash()
+{
+	_StateHash result = RobotKey(robot.first, robot.second);
+	if (liftIsOpen) result ^= LiftKey();
+	for (size_t i = 0; i < mapHeight; i++) {
+		for (size_t j = 0; j < mapWidth; j++) {
+			result ^= CellKey(i, j, Cell(i, j));
+		}
+	}
+	return result;
+}
+
+// Description: Estimates bytes of the field which are not shared with the origin
+//
+// Tiles, bands of bit planes and bands of lambda slots differing from the ones of the origin
+// belong to this copy, the lists are copied anyway. A NULL origin counts all of them.
+size_t Field::GetBytesApartFrom(Field * origin)
+{
+	size_t bytes = sizeof(Field) + tiles.size() * sizeof(FieldTile *) + changedCells.size() * sizeof(size_t);
+	for (size_t i = 0; i < tiles.size(); i++) {
+		if (!origin || i >= origin->tiles.size() || tiles[i] != origin->tiles[i])
+			bytes += sizeof(FieldTile) + tiles[i]->GetSize();
+	}
+	if (bits) bytes += bits->GetBytesApartFrom(origin ? origin->bits : NULL);
+	bytes += lambdas.GetBytesApartFrom(origin ? &origin->lambdas : NULL);
+	return bytes;
+}
+
+// Description: Returns the key of the number; keys are mixed on the fly instead of being stored
+// in a table, because a table for all cells and objects would be bigger than the map itself
+_StateHash Field::ZobristKey(_StateHash number)
+{
+	_StateHash z = (number + 1) * 0x9E3779B97F4A7C15ULL;		// splitmix64
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+// Keys don't depend on the width of the map, so the loader hashes rows before it knows the width
+_StateHash Field::CellKey(size_t x, size_t y, _MineObject OBJECT)
+{
+	return ZobristKey(((((_StateHash) x << 24) | y) << 8) | (unsigned char) OBJECT);
+}
+
+_StateHash Field::RobotKey(size_t x, size_t y)
+{
+	return ZobristKey(((((_StateHash) x << 24) | y) << 8) | 0xFF);
+}
+
+_StateHash Field::LiftKey()
+{
+	return ZobristKey(~0ULL - 1);
+}
+
+// Description: Starts recording of all changes into the empty journal
+void Field::StartJournal()
+{
+	if (!journal) journal = new FieldJournal();
+	journal->Clear();
+}
+
+void Field::StopJournal()
+{
+	delete journal;
+	journal = NULL;
+}
+
+// Description: Returns mark of the current state for RollbackJournal
+size_t Field::MarkJournal()
+{
+	if (!journal) StartJournal();
+	journal->RecordMark(changedCells);
+	return journal->GetSize() - 1;
+}
+
+// Description: Restores the state of the mark by undoing recorded changes in reverse order
+//
+// The cost is proportional to the number of changes made after the mark, not to the map size.
+void Field::RollbackJournal(size_t mark)
+{
+	if (!journal || mark >= journal->GetSize()) return;
+
+	FieldJournal * recording = journal;
+	journal = NULL;		// undoing changes must not record them
+	while (recording->GetSize() > mark + 1) {
+		UndoEntry(recording->GetEntry(recording->GetSize() - 1), recording);
+		recording->PopEntry();
+	}
+	journal = recording;
+
+	// The rocks to check on the next update are the same as they were at the mark
+	changedCells = journal->GetMarkCells(mark);
+}
+
+// Description: Forgets the latest mark; changes made after it now belong to the previous mark
+void Field::ReleaseJournalMark(size_t mark)
+{
+	if (journal && mark < journal->GetSize())
+		journal->EraseMark(mark);
+}
+
+// Description: Undoes one change of the journal, recording must be off
+void Field::UndoEntry(const JournalEntry & entry, FieldJournal * recording)
+{
+	switch (entry.type) {
+	case JOURNAL_CELL:
+		SetObject(entry.x, entry.y, entry.object);
+		break;
+	case JOURNAL_ROBOT:
+		SetRobot(entry.x, entry.y);
+		break;
+	case JOURNAL_LIFT:
+		SetLiftState(entry.object != 0);
+		break;
+	case JOURNAL_DEATH:
+		robotIsDead = false;
+		break;
+	case JOURNAL_ADD_LAMBDA:
+		lambdas.PopBack();
+		break;
+	case JOURNAL_POP_LAMBDA:
+		lambdas.Add(entry.lambda);
+		break;
+	case JOURNAL_ERASE_LAMBDA:
+		lambdas.Insert(entry.x, entry.lambda);
+		break;
+	// The saved state is dropped right after undoing, so it can be taken
+#ifdef HAS_MOVE_SEMANTICS
+	case JOURNAL_CLEAR_LAMBDAS:
+		lambdas = std::move(recording->GetClearedLambdas());
+		break;
+	case JOURNAL_ASSIGN:
+		*this = std::move(recording->GetAssignedField());
+		break;
+#else
+	case JOURNAL_CLEAR_LAMBDAS:
+		lambdas = recording->GetClearedLambdas();
+		break;
+	case JOURNAL_ASSIGN:
+		*this = recording->GetAssignedField();
+		break;
+#endif
+	}
+}
+
 // Description: Changes robot coordinates
 void Field::SetRobot(size_t x, size_t y)
 {
 	if (x < mapHeight && y < mapWidth) {
+		if (journal) journal->Record(JOURNAL_ROBOT, robot.first, robot.second);
+		hash ^= RobotKey(robot.first, robot.second) ^ RobotKey(x, y);
 		robot.first = x;
 		robot.second = y;
 	}
@@ -181,52 +715,56 @@ void Field::SetRobot(size_t x, size_t y)
 
 void Field::SetLiftState(bool isOpen)
 {
+	if (liftIsOpen != isOpen) {
+		if (journal) journal->Record(JOURNAL_LIFT, 0, 0, liftIsOpen);
+		hash ^= LiftKey();
+	}
 	liftIsOpen = isOpen;
 }
 
 void Field::ClearLambdas()
 {
-	lambdas.clear();
+	if (journal) journal->RecordClearLambdas(lambdas);
+	lambdas.Clear();
 }
 
 void Field::AddLambda(IntPair lambda)
 {
-	lambdas.push_back(lambda);
+	if (lambdas.Add(lambda) && journal) journal->Record(JOURNAL_ADD_LAMBDA);
 }
 
 void Field::PopBackLambda()
 {
-	lambdas.pop_back();
+	if (journal) journal->Record(JOURNAL_POP_LAMBDA, 0, 0, 0, lambdas.Back());
+	lambdas.PopBack();
 }
 
 void Field::EraseLambda(IntPair lambda)
 {
-	int index = FindLambda(lambda);
-	if (index != -1) lambdas.erase(lambdas.begin() + index);
+	// The last lambda takes the place of the erased one
+	int index = lambdas.Erase(lambda);
+	if (index != -1 && journal) journal->Record(JOURNAL_ERASE_LAMBDA, index, 0, 0, lambda);
 }
 
 int Field::FindLambda(IntPair lambda)
 {
-	int index = 0;
-	vector<IntPair>::iterator itr = find(lambdas.begin(), lambdas.end(), lambda);
-	if (itr == lambdas.end()) index = -1;
-	else index = distance(lambdas.begin(), itr);
-
-	return index;
+	return lambdas.Find(lambda);
 }
 
 _MineObject Field::GetObject(size_t x, size_t y)
 {
 	if (x < mapHeight && y < mapWidth)
-		return map[x][y];
+		return Cell(x, y);
 	else
 		return '\0';
 }
 
 void Field::SetObject(size_t x, size_t y, _MineObject OBJECT)
 {
-	if (x < mapHeight && y < mapWidth)
-		map[x][y] = OBJECT;
+	if (x < mapHeight && y < mapWidth && Cell(x, y) != OBJECT) {
+		ChangeCell(x, y, OBJECT);
+		if (bits) bits->SetObject(x, y, OBJECT);
+	}
 }
 
 // Description: Returns map width
@@ -241,10 +779,28 @@ int Field::GetHeight()
 	return this->mapHeight;
 }
 
-// Description: Returns map
-char ** Field::GetMap()
+MapAnalysis * Field::GetAnalysis()
+{
+	return this->analysis;
+}
+
+// Description: Returns row view of the map
+Field::MapView Field::GetMap()
 {
-	return this->map;
+	return MapView(this->tiles.empty() ? NULL : &this->tiles[0], this->rowBytes, this->packed);
+}
+
+// Description: Copies cells of the row, packed cells are decoded
+void Field::GetRow(size_t x, _MineObject * cells)
+{
+	if (!packed) {
+		memcpy(cells, Row(x), mapWidth);
+		return;
+	}
+	const _MineObject * row = Row(x);
+	for (size_t j = 0; j < mapWidth; j++) {
+		cells[j] = cellObjects[CellCode(row, j)];
+	}
 }
 
 // Description: Returns robot coordinates
@@ -254,9 +810,21 @@ IntPair Field::GetRobot()
 }
 
 // Description: Returns list of lambda's coordinates for all lambdas on map
-vector<IntPair> Field::GetLambdas()
+const vector<IntPair> & Field::GetLambdas()
 {
-	return this->lambdas;
+	return this->lambdas.GetItems();
+}
+
+// Description: Returns number of lambdas in the list
+size_t Field::GetLambdasNum()
+{
+	return this->lambdas.Size();
+}
+
+// Description: Returns lambda at the position of the list
+IntPair Field::GetLambda(size_t index)
+{
+	return this->lambdas.At(index);
 }
 
 // Description: Returns lift coordinates
@@ -276,121 +844,287 @@ bool Field::IsRobotDead()
 	return this->robotIsDead;
 }
 
-// Description: Updates map according to the rules
-void Field::UpdateMap()
+// Description: Checks the rules for the rock in (i; j) against the current map
+// Returns: true and the column of the cell in the row below where the rock falls to, false if the rock stays
+bool Field::FindRockMove(size_t i, size_t j, size_t & targetY)
 {
-	// Creating new state to record changes on the map
-	char ** newState = new _MineObject * [mapHeight];
-	for (size_t i = 0; i < mapHeight; i++) {
-		newState[i] = new _MineObject [mapWidth];
-		for (size_t j = 0; j < mapWidth; j++) {
-			newState[i][j] = WALL;
-		}
+	// Packed cells are compared by their codes, so nothing is decoded here
+	unsigned char stone = STONE, empty = EMPTY, lambda = LAMBDA;
+	if (packed) {
+		stone = STONE_CODE;
+		empty = EMPTY_CODE;
+		lambda = LAMBDA_CODE;
 	}
+	const _MineObject * row = Row(i);
+	const _MineObject * below = Row(i + 1);
 
-	for (size_t i = 1; i < mapHeight - 1; i++) {
-		for (size_t j = 1; j < mapWidth - 1; j++) {
-			// If (x; y) contains a Rock, and (x; y-1) is Empty:
-			// (x; y) is updated to Empty, (x; y-1) is updated to Rock.
-			if (map[i][j] == STONE && map[i + 1][j] == EMPTY) {
-				newState[i][j] = EMPTY;
-				newState[i + 1][j] = STONE;
-				if (map[i + 2][j] == ROBOT)
-					robotIsDead = true;
-			}
-			// If (x; y) contains a Rock, (x; y-1) contains a Rock, (x+1; y) is Empty and (x+1; y-1) is Empty:
-			// (x; y) is updated to Empty, (x+1; y-1) is updated to Rock.
-			else if (map[i][j] == STONE && map[i + 1][j] == STONE
-				&& map[i][j + 1] == EMPTY && map[i + 1][j + 1] == EMPTY) {
-					newState[i][j] = EMPTY;
-					newState[i + 1][j + 1] = STONE;
-					if (map[i + 2][j + 1] == ROBOT) 
-						robotIsDead = true;
-			}
-			// If (x; y) contains a Rock, (x; y-1) contains a Rock, either (x+1; y) is not Empty
-			// or (x+1; y-1) is not Empty, (x-1; y) is Empty and (x-1; y-1) is Empty:
-			// (x; y) is updated to Empty, (x-1; y-1) is updated to Rock.
-			else if (map[i][j] == STONE && map[i + 1][j] == STONE
-				&& (map[i][j + 1] != EMPTY || map[i + 1][j + 1] != EMPTY)
-				&& map[i][j - 1] == EMPTY && map[i + 1][j - 1] == EMPTY) {
-					newState[i][j] = EMPTY;
-					newState[i + 1][j - 1] = STONE;
-					if (map[i + 2][j - 1] == ROBOT) 
-						robotIsDead = true;
-			}
-			// If (x; y) contains a Rock, (x; y-1) contains a Lambda, (x+1; y) is Empty and (x+1; y-1) is Empty:
-			// (x; y) is updated to Empty, (x+1; y-1) is updated to Rock.
-			else if (map[i][j] == STONE && map[i + 1][j] == LAMBDA
-				&& map[i][j + 1] == EMPTY && map[i + 1][j + 1] == EMPTY) {
-					newState[i][j] = EMPTY;
-					newState[i + 1][j + 1] = STONE;
-					if (map[i + 2][j + 1] == ROBOT) 
-						robotIsDead = true;
+	if (Kind(row, j) != stone) return false;
+
+	// If (x; y) contains a Rock, and (x; y-1) is Empty:
+	// (x; y) is updated to Empty, (x; y-1) is updated to Rock.
+	if (Kind(below, j) == empty) {
+		targetY = j;
+		return true;
+	}
+	// If (x; y) contains a Rock, (x; y-1) contains a Rock, (x+1; y) is Empty and (x+1; y-1) is Empty:
+	// (x; y) is updated to Empty, (x+1; y-1) is updated to Rock.
+	if (Kind(below, j) == stone && Kind(row, j + 1) == empty && Kind(below, j + 1) == empty) {
+		targetY = j + 1;
+		return true;
+	}
+	// If (x; y) contains a Rock, (x; y-1) contains a Rock, either (x+1; y) is not Empty
+	// or (x+1; y-1) is not Empty, (x-1; y) is Empty and (x-1; y-1) is Empty:
+	// (x; y) is updated to Empty, (x-1; y-1) is updated to Rock.
+	if (Kind(below, j) == stone && Kind(row, j - 1) == empty && Kind(below, j - 1) == empty) {
+		targetY = j - 1;
+		return true;
+	}
+	// If (x; y) contains a Rock, (x; y-1) contains a Lambda, (x+1; y) is Empty and (x+1; y-1) is Empty:
+	// (x; y) is updated to Empty, (x+1; y-1) is updated to Rock.
+	if (Kind(below, j) == lambda && Kind(row, j + 1) == empty && Kind(below, j + 1) == empty) {
+		targetY = j + 1;
+		return true;
+	}
+	// In all other cases, (x; y) remains unchanged.
+	return false;
+}
+
+// Description: Writes the object into the cell, updates the hash and remembers the change
+void Field::ChangeCell(size_t x, size_t y, _MineObject OBJECT)
+{
+	if (packed && EncodeObject(OBJECT) == -1)
+		SetStorage(BYTE_STORAGE);		// there are more kinds of objects than codes
+
+	_MineObject old = Cell(x, y);
+	if (journal) journal->Record(JOURNAL_CELL, x, y, old);
+	hash ^= CellKey(x, y, old) ^ CellKey(x, y, OBJECT);
+	PutCell(MutableRow(x), y, OBJECT);
+	MarkChanged(x, y);
+}
+
+void Field::KillRobot()
+{
+	if (!robotIsDead && journal) journal->Record(JOURNAL_DEATH);
+	robotIsDead = true;
+}
+
+// Description: Remembers that the cell has been changed, so the rocks around it are checked on the next update
+void Field::MarkChanged(size_t x, size_t y)
+{
+	changedCells.push_back(x * mapStride + y);
+}
+
+// Description: Updates map according to the rules
+//
+// Only the rocks whose neighbourhood has changed since the previous update can move, so instead of
+// scanning the whole map we check the rocks around the changed cells. A rock in (i; j) looks at
+// (i; j-1..j+1) and (i+1; j-1..j+1), so a change in (x; y) may wake up rocks in (x-1..x; y-1..y+1).
+// All rules read the old state and the cells they write never overlap, so the order doesn't matter.
+// Returns: true if a rock has moved or the lift has opened
+bool Field::UpdateMap()
+{
+	bool wasOpen = liftIsOpen;
+	if (bits) {
+		UpdateRocksByBitField();
+	} else {
+		vector<size_t> active;
+		CollectActiveCells(active);
+		changedCells.clear();
+
+		// Finding all rocks which move during this update
+		vector<IntPair> moves;	// pairs of (from; to) cell indexes
+		for (size_t k = 0; k < active.size(); k++) {
+			size_t i = active[k] / mapStride;
+			size_t j = active[k] % mapStride;
+			size_t targetY;
+			if (FindRockMove(i, j, targetY)) {
+				moves.push_back(IntPair(active[k], (i + 1) * mapStride + targetY));
+				if (Cell(i + 2, targetY) == ROBOT)
+					KillRobot();
 			}
-			// In all other cases, (x; y) remains unchanged.
+		}
+
+		// Rewriting old map according to the new state
+		for (size_t k = 0; k < moves.size(); k++) {
+			ChangeCell(moves[k].first / mapStride, moves[k].first % mapStride, EMPTY);
+		}
+		for (size_t k = 0; k < moves.size(); k++) {
+			ChangeCell(moves[k].second / mapStride, moves[k].second % mapStride, STONE);
 		}
 	}
+
 	// If (x; y) contains a Closed Lambda Lift, and there are no Lambdas remaining:
 	// (x; y) is updated to Open Lambda Lift.
-	if (lambdas.empty()) {
+	if (lambdas.Empty()) {
 		SetLiftState(true);
-		newState[lift.first][lift.second] = OPENED_LIFT;
+		SetObject(lift.first, lift.second, OPENED_LIFT);
 	}
+	return !changedCells.empty() || liftIsOpen != wasOpen;
+}
 
-	// Rewriting old map according to the new state
-	for (size_t i = 0; i < mapHeight; i++) {
-		for (size_t j = 0; j < mapWidth; j++) {
-			if (newState[i][j] != WALL) map[i][j] = newState[i][j];
+// Description: Advances the world with the robot standing still until nothing moves,
+// the robot dies or maxTicks ticks are made
+// Returns: number of ticks made; robotDied is set if a rock has fallen on the robot
+//
+// Every tick only wakes the rocks around the cells changed by the previous one, so a falling
+// rock costs a few cells per tick however big the map is. The first tick which changes nothing
+// ends settling, so the mine isn't probed by IsStable before every tick.
+int Field::Settle(int maxTicks, bool & robotDied)
+{
+	int ticks = 0;
+	while (ticks < maxTicks && !robotIsDead && UpdateMap()) {
+		ticks++;
+	}
+	robotDied = robotIsDead;
+	return ticks;
+}
+
+// Description: Checks whether the next update would change nothing
+bool Field::IsStable()
+{
+	if (lambdas.Empty() && (!liftIsOpen || GetObject(lift.first, lift.second) != OPENED_LIFT))
+		return false;
+
+	vector<size_t> active;
+	CollectActiveCells(active);
+	for (size_t k = 0; k < active.size(); k++) {
+		size_t targetY;
+		if (FindRockMove(active[k] / mapStride, active[k] % mapStride, targetY))
+			return false;
+	}
+	return true;
+}
+
+// Description: Lists the cells whose rocks may move on the next update, i.e. the cells around changed ones
+void Field::CollectActiveCells(vector<size_t> & active)
+{
+	active.reserve(changedCells.size() * 6);
+	for (size_t k = 0; k < changedCells.size(); k++) {
+		size_t x = changedCells[k] / mapStride;
+		size_t y = changedCells[k] % mapStride;
+		for (size_t i = (x > 1 ? x - 1 : 1); i <= x && i < mapHeight - 1; i++) {
+			for (size_t j = (y > 1 ? y - 1 : 1); j <= y + 1 && j < mapWidth - 1; j++) {
+				active.push_back(i * mapStride + j);
+			}
 		}
 	}
+	sort(active.begin(), active.end());
+	active.erase(unique(active.begin(), active.end()), active.end());
+}
 
-	// Freeing memory
-	for (size_t i = 0; i < mapHeight; i++)
-		delete [] newState[i];
+// Description: Moves rocks using word-parallel rules of the bit planes
+void Field::UpdateRocksByBitField()
+{
+	vector<IntPair> freed, filled;
+	if (bits->UpdateMap(freed, filled))
+		KillRobot();
+
+	changedCells.clear();
+	for (size_t k = 0; k < freed.size(); k++) {
+		ChangeCell(freed[k].first, freed[k].second, EMPTY);
+	}
+	for (size_t k = 0; k < filled.size(); k++) {
+		ChangeCell(filled[k].first, filled[k].second, STONE);
+	}
 }
 
 // Description: Checks, whether robot can go on this cage or not
 bool Field::isWalkable(int x, int y)																						// TBD: add some euristic
 {
 	// Avoid 'index out of bounds' situations
-	if (x >= (int) mapHeight || y >= (int) mapWidth) return false;
-	if (x < 0 || y < 0) return false;
-
 	// If there is a wall, then robot fails
-	if (map[x][y] == WALL) return false;
+	if (!analysis->IsOpen(x, y)) return false;
 	// On the other side, robot can't go on right or left cage concerning him
 	// if there is a stone in this cage and there is something in next cage
-	if (map[x][y] == STONE) {										// If there is a stone in this cage:
+	if (Cell(x, y) == STONE) {										// If there is a stone in this cage:
 		if (x == robot.first && y - 1 == robot.second) {			// then, if robot is to the left of a cage
-			if (map[x][y + 1] == EMPTY) return true;				// then robot succeeds if the right cage near stone is empty
+			if (Cell(x, y + 1) == EMPTY) return true;				// then robot succeeds if the right cage near stone is empty
 		} else if (x == robot.first && y + 1 == robot.second) {		// otherwise, if robot is to the right of a cage
-			if (map[x][y - 1] == EMPTY) return true;				// then robot succeeds if the left cage near stone is empty.
+			if (Cell(x, y - 1) == EMPTY) return true;				// then robot succeeds if the left cage near stone is empty.
 		}
 		return false;												// Robot fails in all other cases (i.e. next cage isn't empty).
 	}
 	// If there is a closed lift, then robot fails
-	if (map[x][y] == CLOSED_LIFT) return false;
+	if (Cell(x, y) == CLOSED_LIFT) return false;
 	// Robot succeeds in all other cases.
 	// I.e. there is an earth, lambda or an open lift in the cage or the cage is empty.
 	return true;
 }
 
-Field Field::operator = (const Field & field)
+Field & Field::operator = (const Field & field)
 {
+	if (this == &field) return *this;
+	if (journal) journal->RecordAssign(*this);
+
+	robot = field.robot;
+	lambdas = field.lambdas;
+	lift = field.lift;
+	liftIsOpen = field.liftIsOpen;
+	robotIsDead = field.robotIsDead;
+	hash = field.hash;
+	changedCells = field.changedCells;
+	if (field.bits) {
+		if (bits) *bits = *field.bits;
+		else bits = new BitField(*field.bits);
+	} else {
+		delete bits;
+		bits = NULL;
+	}
+
+	if (field.analysis) field.analysis->Retain();
+	if (analysis) analysis->Release();
+	analysis = field.analysis;
+
+	// Share the tiles of the other Field
+	for (size_t i = 0; i < field.tiles.size(); i++)
+		field.tiles[i]->Retain();
+	FreeMap();
+	tiles = field.tiles;
+	mapStride = field.mapStride;
+	rowBytes = field.rowBytes;
+	packed = field.packed;
 	mapWidth = field.mapWidth;
 	mapHeight = field.mapHeight;
+
+	return *this;
+}
+
+#ifdef HAS_MOVE_SEMANTICS
+// Description: Takes tiles, bit planes and lists of the field; the field is left without a map
+Field & Field::operator = (Field && field)
+{
+	if (this == &field) return *this;
+	if (journal) journal->RecordAssign(*this);
+
 	robot = field.robot;
-	lambdas = field.lambdas;
+	lambdas = std::move(field.lambdas);
 	lift = field.lift;
 	liftIsOpen = field.liftIsOpen;
+	robotIsDead = field.robotIsDead;
+	hash = field.hash;
+	changedCells = std::move(field.changedCells);
+	delete bits;
+	bits = field.bits;
+	field.bits = NULL;
+	if (analysis) analysis->Release();
+	analysis = field.analysis;
+	field.analysis = NULL;
 
-	map = new _MineObject * [field.mapHeight];
-	for (size_t i = 0; i < field.mapHeight; i++) {
-		map[i] = new _MineObject [field.mapWidth];
-		for (size_t j = 0; j < field.mapWidth; j++) {
-			map[i][j] = field.map[i][j];
-		}
-	}
+	FreeMap();
+	tiles = std::move(field.tiles);
+	mapStride = field.mapStride;
+	rowBytes = field.rowBytes;
+	packed = field.packed;
+	mapWidth = field.mapWidth;
+	mapHeight = field.mapHeight;
+
+	field.tiles.clear();
+	field.changedCells.clear();
+	field.mapWidth = -1;
+	field.mapHeight = -1;
+	field.mapStride = 0;
+	field.rowBytes = 0;
 
 	return *this;
 }
+#endif
@@ -1,50 +1,181 @@
 #pragma once
 
 #include "stdafx.h"
+#include "BitField.h"
+#include "FieldTile.h"
+#include "LambdaSet.h"
+#include "MapAnalysis.h"
+
+class FieldJournal;
+struct JournalEntry;
 
 class Field
 {
 	size_t mapWidth;
 	size_t mapHeight;
-	_MineObject ** map;
+	size_t mapStride;		// cells in one row of a tile (width rounded up, see FIELD_STRIDE_ALIGN)
+	size_t rowBytes;		// bytes in one row of a tile, half of mapStride when cells are packed
+	bool packed;			// PACKED_STORAGE: cells are kept as 4-bit codes, see cellObjects
+	vector<FieldTile *> tiles;	// bands of FIELD_TILE_ROWS rows covering mapHeight + 1 rows, the last one is a guard row
 	IntPair robot;
-	vector<IntPair> lambdas;
+	LambdaSet lambdas;
 	IntPair lift;
 	bool liftIsOpen;
 	bool robotIsDead;
+	vector<size_t> changedCells;	// cells changed since the last update; only rocks around them can move
+	BitField * bits;				// bit planes mirroring the map when BITBOARD_BACKEND is used, NULL otherwise
+	_StateHash hash;				// Zobrist hash of the state, see GetHash()
+	FieldJournal * journal;			// undo journal while recording is on, NULL otherwise; not copied
+	MapAnalysis * analysis;			// static facts about the map made by LoadMap, shared by copies
 
 public:
+	// Read-only view of one row, decodes packed cells
+	class RowView
+	{
+		const _MineObject * cells;
+		bool packed;
+	public:
+		RowView(const _MineObject * acells, bool apacked) : cells(acells), packed(apacked) {}
+		_MineObject operator [] (size_t y) const
+		{
+			return packed ? cellObjects[CellCode(cells, y)] : cells[y];
+		}
+	};
+
+	// Read-only view of the map which keeps map[x][y] syntax working for GUI and solvers
+	class MapView
+	{
+		FieldTile * const * tiles;
+		size_t rowBytes;
+		bool packed;
+	public:
+		MapView(FieldTile * const * atiles, size_t arowBytes, bool apacked) : tiles(atiles), rowBytes(arowBytes), packed(apacked) {}
+		RowView operator [] (size_t x) const
+		{
+			return RowView(tiles[x / FIELD_TILE_ROWS]->GetCells() + (x % FIELD_TILE_ROWS) * rowBytes, packed);
+		}
+	};
+
 	Field(void);
 	Field(const Field & field);
+#ifdef HAS_MOVE_SEMANTICS
+	Field(Field && field);				// takes tiles of the field, which becomes empty
+#endif
 	~Field(void);
 
-	int LoadMap(istream &sin);		// loads map from file; fills Field's fields =)
+	int LoadMap(istream &sin);		// loads map from stream; fills Field's fields =)
+	int LoadMap(const char * fileName);	// loads map from file
 	void SaveMap(ostream &sout);
 	int CheckMine();
 
+	void SetBackend(int backend);	// GRID_BACKEND or BITBOARD_BACKEND
+	int GetBackend();
+	int CheckBitField();			// compares bit planes with the map
+
+	int SetStorage(int storage);	// BYTE_STORAGE or PACKED_STORAGE; returns -1 if the map can't be packed
+	int GetStorage();
+
+	_StateHash GetHash();			// returns hash of the state, maintained incrementally
+	_StateHash ComputeHash();		// calculates hash of the state from scratch
+	size_t GetBytesApartFrom(Field * origin);	// estimates memory held only by this changed copy of the origin
+
+	void StartJournal();			// starts recording of all changes into the empty journal
+	void StopJournal();				// stops recording and drops the journal
+	size_t MarkJournal();			// returns mark of the current state
+	void RollbackJournal(size_t mark);	// undoes all changes made after the mark; the mark stays valid
+	void ReleaseJournalMark(size_t mark);	// forgets the latest mark, changes made after it are kept
+
 	void SetRobot(size_t x, size_t y);	// changes robot coordinates
 	void SetLiftState(bool isOpen);
 	void ClearLambdas();
 	void AddLambda(IntPair lambda);
 	void PopBackLambda();
 	void EraseLambda(IntPair lambda);
-	int FindLambda(IntPair lambda);
+	int FindLambda(IntPair lambda);	// returns position of lambda in the list or -1
 
 	_MineObject GetObject(size_t x, size_t y);
 	void SetObject(size_t x, size_t y, _MineObject OBJECT);
 
 	int GetWidth();
 	int GetHeight();
-	char ** GetMap();				// returns pointer to map
+	MapAnalysis * GetAnalysis();	// returns analysis of the walls and rocks of the loaded map
+	MapView GetMap();				// returns row view of the map
+	void GetRow(size_t x, _MineObject * cells);	// copies width cells of the row
 	IntPair GetRobot();		// returns robot coordinates
-	vector<IntPair> GetLambdas();		// returns list of lambda's coordinates for all lambdas on map
+	const vector<IntPair> & GetLambdas();	// returns list of lambda's coordinates for all lambdas on map
+	size_t GetLambdasNum();
+	IntPair GetLambda(size_t index);
 	IntPair GetLift();					// returns lift coordinates
 	bool isLiftOpened();			// returns the state of the lift
 	bool IsRobotDead();
 
-	void UpdateMap();	// updates map according to the rules
+	bool UpdateMap();	// updates map according to the rules; returns false if nothing has changed
+	int Settle(int maxTicks, bool & robotDied);	// waits until nothing moves; returns number of ticks
+	bool IsStable();	// checks whether the next update would change nothing
 	bool isWalkable(int x, int y);
 
 
-	Field operator = (const Field & field);
+	Field & operator = (const Field & field);
+#ifdef HAS_MOVE_SEMANTICS
+	Field & operator = (Field && field);
+#endif
+
+private:
+	static _MineObject cellObjects[16];	// objects of the 4-bit cell codes
+	static int cellObjectsNum;
+	static unsigned char cellCodes[256];	// code + 1 of every object, 0 if it has no code yet
+	static const bool fixedCodes;		// the first objects have their codes, see CodeFixedObjects
+
+	static unsigned char CellCode(const _MineObject * row, size_t y)
+	{
+		return ((unsigned char) row[y >> 1] >> ((y & 1) << 2)) & 0xF;
+	}
+	static int EncodeObject(_MineObject OBJECT);	// returns code of the object or -1 if it has no code
+	static int AddObjectCode(_MineObject OBJECT);
+	static bool CodeFixedObjects();
+
+	const _MineObject * Row(size_t x)
+	{
+		return tiles[x / FIELD_TILE_ROWS]->GetCells() + (x % FIELD_TILE_ROWS) * rowBytes;
+	}
+	unsigned char Kind(const _MineObject * row, size_t y)	// code of the packed cell or the object itself
+	{
+		return packed ? CellCode(row, y) : (unsigned char) row[y];
+	}
+	_MineObject Cell(size_t x, size_t y)
+	{
+		return packed ? cellObjects[CellCode(Row(x), y)] : Row(x)[y];
+	}
+	_MineObject * MutableRow(size_t x);	// makes the tile private before writing into it
+	void PutCell(_MineObject * row, size_t y, _MineObject OBJECT);
+	bool PackRow(_MineObject * row, const char * text, size_t length);
+
+	// Rows met by the loader which are finished only when the width of the map is known
+	struct LoadedRows
+	{
+		vector<size_t> lengths;		// length of the text of every row
+		vector<IntPair> lambdas;
+	};
+
+	int ParseMap(const char * data, size_t size);
+	void ParseRows(const char * data, size_t size, string & rest, LoadedRows & rows);
+	void BeginMap();
+	void AddRow(const char * text, size_t length, LoadedRows & rows);
+	int EndMap(LoadedRows & rows);
+	void RestrideMap(size_t stride, bool pack);
+	void AllocateMap(size_t width, size_t height);
+	void ChangeCell(size_t x, size_t y, _MineObject OBJECT);
+	void KillRobot();
+	void UndoEntry(const JournalEntry & entry, FieldJournal * recording);
+	void MarkChanged(size_t x, size_t y);
+	void CollectActiveCells(vector<size_t> & active);
+	bool FindRockMove(size_t i, size_t j, size_t & targetY);
+	void UpdateRocksByBitField();
+	void BuildBitField();
+
+	static _StateHash ZobristKey(_StateHash number);
+	_StateHash CellKey(size_t x, size_t y, _MineObject OBJECT);
+	_StateHash RobotKey(size_t x, size_t y);
+	_StateHash LiftKey();
+	void FreeMap();
 };
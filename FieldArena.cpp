@@ -0,0 +1,46 @@
+#include "FieldArena.h"
+#include "FieldTile.h"
+
+// Every thread has its own arena, so pools are never shared between threads
+static __thread FieldArena * currentArena = NULL;
+
+
+FieldArena::FieldArena(void)
+{
+	outer = currentArena;
+	if (!outer) currentArena = this;
+}
+
+FieldArena::~FieldArena(void)
+{
+	if (outer) return;
+
+	currentArena = NULL;
+	for (size_t i = 0; i < tiles.size(); i++)
+		FieldTile::Destroy(tiles[i]);
+}
+
+FieldArena * FieldArena::GetCurrent()
+{
+	return currentArena;
+}
+
+FieldTile * FieldArena::TakeTile(size_t size)
+{
+	if (tiles.empty() || tiles.back()->GetSize() != size) return NULL;
+
+	FieldTile * tile = tiles.back();
+	tiles.pop_back();
+	return tile;
+}
+
+void FieldArena::KeepTile(FieldTile * tile)
+{
+	// Tiles of another map can't be reused by this one
+	if (!tiles.empty() && tiles.back()->GetSize() != tile->GetSize()) {
+		for (size_t i = 0; i < tiles.size(); i++)
+			FieldTile::Destroy(tiles[i]);
+		tiles.clear();
+	}
+	tiles.push_back(tile);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "stdafx.h"
+
+class FieldTile;
+
+// Pool of the tiles of Fields copied during one search.
+// While an arena lives, tiles released by the Fields of its thread are kept in the arena and are
+// given to the next Fields instead of new ones, so copying Fields in the search loop doesn't call malloc.
+// Tiles still held by Fields when the arena is destroyed stay valid; pooled ones are freed at once.
+// Arenas created while another one lives in the same thread share the outer pool.
+class FieldArena
+{
+	vector<FieldTile *> tiles;		// released tiles ready for reuse, all of the same size
+	FieldArena * outer;
+
+public:
+	FieldArena(void);
+	~FieldArena(void);
+
+	static FieldArena * GetCurrent();		// returns arena of the calling thread or NULL
+
+	FieldTile * TakeTile(size_t size);		// returns pooled tile of the size or NULL
+	void KeepTile(FieldTile * tile);		// pools the released tile
+};
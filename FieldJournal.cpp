@@ -0,0 +1,109 @@
+#include "FieldJournal.h"
+
+
+FieldJournal::FieldJournal(void)
+{
+}
+
+FieldJournal::~FieldJournal(void)
+{
+}
+
+void FieldJournal::Clear()
+{
+	entries.clear();
+	fields.clear();
+	changedCells.clear();
+	lambdaLists.clear();
+}
+
+size_t FieldJournal::GetSize()
+{
+	return entries.size();
+}
+
+JournalEntry & FieldJournal::GetEntry(size_t index)
+{
+	return entries[index];
+}
+
+void FieldJournal::Record(int type, size_t x, size_t y, _MineObject object, IntPair lambda)
+{
+	JournalEntry entry;
+	entry.type = type;
+	entry.x = x;
+	entry.y = y;
+	entry.object = object;
+	entry.lambda = lambda;
+	entries.push_back(entry);
+}
+
+// Description: Records the mark; x holds the index of the saved changed cells
+void FieldJournal::RecordMark(const vector<size_t> & cells)
+{
+	changedCells.push_back(cells);
+	Record(JOURNAL_MARK, changedCells.size() - 1);
+}
+
+// Description: Records the state replaced by assignment; tiles are shared, so it is cheap
+void FieldJournal::RecordAssign(const Field & field)
+{
+	// If there is no mark since the previous assignment, nothing after it can be undone alone:
+	// rollback to any earlier mark restores the state saved by the previous assignment anyway.
+	for (size_t i = entries.size(); i > 0; i--) {
+		if (entries[i - 1].type == JOURNAL_MARK) break;
+		if (entries[i - 1].type == JOURNAL_ASSIGN) {
+			while (entries.size() > i) PopEntry();
+			return;
+		}
+	}
+
+	fields.push_back(field);
+	Record(JOURNAL_ASSIGN);
+}
+
+void FieldJournal::RecordClearLambdas(const LambdaSet & lambdas)
+{
+	lambdaLists.push_back(lambdas);
+	Record(JOURNAL_CLEAR_LAMBDAS);
+}
+
+// Description: Removes the last entry with its saved data
+void FieldJournal::PopEntry()
+{
+	switch (entries.back().type) {
+	case JOURNAL_MARK:
+		changedCells.pop_back();
+		break;
+	case JOURNAL_ASSIGN:
+		fields.pop_back();
+		break;
+	case JOURNAL_CLEAR_LAMBDAS:
+		lambdaLists.pop_back();
+		break;
+	}
+	entries.pop_back();
+}
+
+// Description: Removes the mark entry; marks have to be removed in reverse order of creation
+void FieldJournal::EraseMark(size_t index)
+{
+	if (entries[index].type != JOURNAL_MARK || entries[index].x != changedCells.size() - 1) return;
+	changedCells.pop_back();
+	entries.erase(entries.begin() + index);
+}
+
+vector<size_t> & FieldJournal::GetMarkCells(size_t index)
+{
+	return changedCells[entries[index].x];
+}
+
+Field & FieldJournal::GetAssignedField()
+{
+	return fields.back();
+}
+
+LambdaSet & FieldJournal::GetClearedLambdas()
+{
+	return lambdaLists.back();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Field.h"
+
+#define JOURNAL_MARK 0			// mark set by Field::MarkJournal
+#define JOURNAL_CELL 1			// object in the cell (x; y) was changed
+#define JOURNAL_ROBOT 2			// robot was moved from (x; y)
+#define JOURNAL_LIFT 3			// lift state was changed
+#define JOURNAL_DEATH 4			// robot was killed
+#define JOURNAL_ADD_LAMBDA 5	// lambda was added to the end of the list
+#define JOURNAL_POP_LAMBDA 6	// lambda was removed from the end of the list
+#define JOURNAL_ERASE_LAMBDA 7	// lambda was removed from the position x of the list, the last one took its place
+#define JOURNAL_CLEAR_LAMBDAS 8	// list of lambdas was cleared
+#define JOURNAL_ASSIGN 9		// the whole Field was replaced by assignment or by loading
+
+// Record of one change made to a Field, enough to undo it
+struct JournalEntry
+{
+	int type;
+	size_t x, y;
+	_MineObject object;		// old object in the cell or old lift state
+	IntPair lambda;			// removed lambda
+};
+
+// Undo journal of a Field. Entries are appended by Field while recording is on and
+// are undone in reverse order by Field::RollbackJournal.
+class FieldJournal
+{
+	vector<JournalEntry> entries;
+	vector<Field> fields;						// states replaced by JOURNAL_ASSIGN entries
+	vector< vector<size_t> > changedCells;		// changed cells saved by JOURNAL_MARK entries
+	vector<LambdaSet> lambdaLists;				// lists removed by JOURNAL_CLEAR_LAMBDAS entries
+
+public:
+	FieldJournal(void);
+	~FieldJournal(void);
+
+	void Clear();
+	size_t GetSize();
+	JournalEntry & GetEntry(size_t index);
+
+	void Record(int type, size_t x = 0, size_t y = 0, _MineObject object = 0, IntPair lambda = IntPair());
+	void RecordMark(const vector<size_t> & cells);
+	void RecordAssign(const Field & field);
+	void RecordClearLambdas(const LambdaSet & lambdas);
+
+	void PopEntry();
+	void EraseMark(size_t index);					// removes the latest mark, later entries stay
+	vector<size_t> & GetMarkCells(size_t index);	// returns changed cells of the mark at index
+	Field & GetAssignedField();						// returns state of the last JOURNAL_ASSIGN entry
+	LambdaSet & GetClearedLambdas();				// returns list of the last JOURNAL_CLEAR_LAMBDAS entry
+};
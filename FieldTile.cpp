@@ -0,0 +1,64 @@
+#include "FieldTile.h"
+#include "FieldArena.h"
+
+
+FieldTile::FieldTile(size_t asize)
+{
+	refs = 1;
+	size = asize;
+	cells = new _MineObject [size];
+}
+
+FieldTile::~FieldTile(void)
+{
+	delete [] cells;
+}
+
+// Description: Takes the tile from the arena of the thread if there is one, allocates it otherwise
+FieldTile * FieldTile::Create(size_t size)
+{
+	FieldArena * arena = FieldArena::GetCurrent();
+	FieldTile * tile = arena ? arena->TakeTile(size) : NULL;
+	if (tile) {
+		tile->refs = 1;
+		return tile;
+	}
+	return new FieldTile(size);
+}
+
+void FieldTile::Destroy(FieldTile * tile)
+{
+	delete tile;
+}
+
+FieldTile * FieldTile::Clone()
+{
+	FieldTile * tile = Create(size);
+	memcpy(tile->cells, cells, size);
+	return tile;
+}
+
+// Reference counter is changed and read atomically, so Fields sharing tiles may live in different threads
+void FieldTile::Retain()
+{
+	__sync_fetch_and_add(&refs, 1);
+}
+
+void FieldTile::Release()
+{
+	if (__sync_sub_and_fetch(&refs, 1) == 0) {
+		FieldArena * arena = FieldArena::GetCurrent();
+		if (arena) arena->KeepTile(this);
+		else delete this;
+	}
+}
+
+bool FieldTile::IsShared()
+{
+	return __sync_fetch_and_add(&refs, 0) > 1;
+}
+
+size_t FieldTile::GetSize()
+{
+	return size;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "stdafx.h"
+
+// Band of FIELD_TILE_ROWS map rows shared by Field copies.
+// Copying a Field only retains its tiles; a tile is cloned by the Field which writes into it
+// while somebody else still holds it (copy-on-write).
+class FieldTile
+{
+	int refs;				// number of Fields holding the tile
+	size_t size;
+	_MineObject * cells;
+
+	FieldTile(size_t asize);
+	~FieldTile(void);
+
+public:
+	static FieldTile * Create(size_t size);	// returns tile held by the caller only, its cells aren't initialized
+	static void Destroy(FieldTile * tile);	// frees the tile pooled by FieldArena
+	FieldTile * Clone();					// returns private copy of the tile
+
+	void Retain();
+	void Release();							// deletes or pools the tile when nobody holds it
+	bool IsShared();
+
+	_MineObject * GetCells() { return cells; }	// defined here, Field reads cells through it on every access
+	size_t GetSize();
+};
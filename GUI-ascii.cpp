@@ -159,11 +159,14 @@ void GUI::solve_map(void) {
             game.Solve(1);
             pthread_create(&t, NULL, fun, NULL);
             if (game.GetResult() == 0) {
-                for (unsigned int i = 0; i < game.GetTrace().size(); i++) {
+                // Moves made below are appended to the trace, only the solution is played
+                size_t solutionSize = game.GetTrace().size();
+                for (size_t i = 0; i < solutionSize; i++) {
+                    _Command command = game.GetTrace()[i];
                     RobotCentred();
                     history->SaveState(game);
-                    game.MoveRobot(game.GetTrace()[i]);
-                    str += game.GetTrace()[i];
+                    game.MoveRobot(command);
+                    str += command;
                     resize_refresh();
                     pthread_mutex_lock(&mutex);
                     usleep(SleepTime);
@@ -708,7 +711,7 @@ WINDOW **GUI::draw_game_win() {
     return frames;
 }
 
-void GUI::draw_map(char **map, int column, int row, int start_x, int start_y, WINDOW *game_win) {
+void GUI::draw_map(Field::MapView map, int column, int row, int start_x, int start_y, WINDOW *game_win) {
     WINDOW *gameWin = subwin(game_win, y - 11, x - 22, 5, 3);
     wbkgd(gameWin, COLOR_PAIR(2));
     for (int i = start_y; i <= row; i++) {
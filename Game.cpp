@@ -1,5 +1,11 @@
 #include "Game.h"
-#include "Simulator.h"
+#include "TourEvaluator.h"
+#include "StatePlanner.h"
+#include "BeamSolver.h"
+#include "MctsSolver.h"
+#include "TraceOptimizer.h"
+#include "Deadline.h"
+#include <limits.h>
 
 
 Game::Game(void)
@@ -8,6 +14,17 @@ Game::Game(void)
 	moves = 0;
 	lambdas_collected = 0;
 	game_result = 0;
+	snapshotBudget = SEARCH_SNAPSHOT_BUDGET;
+	walkDistance = SAFE_WALK_MIN_DISTANCE;
+	planner = CELL_PLANNER;
+	beamWidth = BEAM_WIDTH;
+	beamThreads = BEAM_THREADS;
+	mctsIterations = MCTS_ITERATIONS;
+	mctsThreads = MCTS_THREADS;
+	tourCandidates = TOUR_CANDIDATES;
+	tourThreads = TOUR_THREADS;
+	traceThreads = TRACE_THREADS;
+	searchNodes = 0;
 }
 
 
@@ -21,13 +38,28 @@ int Game::Init(istream &sin)
 	if (result != 0)
 		return -1;
 
+	Restart();
+	return 0;
+}
+
+int Game::Init(const char * fileName)
+{
+	int result = mine.LoadMap(fileName);
+	if (result != 0)
+		return -1;
+
+	Restart();
+	return 0;
+}
+
+// Description: Resets score, moves and trace of the game
+void Game::Restart()
+{
 	score = 0;
 	moves = 0;
 	lambdas_collected = 0;
 	game_result = 0;
 	trace.clear();
-
-	return 0;
 }
 
 Field *Game::GetField(void)
@@ -47,7 +79,7 @@ int Game::GetCollectedLambdasNum(void)
 {
 	return this->lambdas_collected;
 }
-vector<_Command> Game::GetTrace(void)
+const vector<_Command> & Game::GetTrace(void)
 {
 	return this->trace;
 }
@@ -62,22 +94,176 @@ void Game::SetGameResult(_GameResult result)
 	game_result = result;
 }
 
+// Description: Finds the trace of the game. Aborting at once is the first trace, the planner's ones
+// replace it if they score more, and the best one is shortened. With a time limit the rest of the
+// budget goes to wider and wider beams, each better trace is shortened again. Every phase stops when
+// the budget ends, so the best trace found so far is kept.
 void Game::Solve(const int & iterations)
 {
+	vector<_Command> best;
+	int bestScore = INT_MIN;
+	searchNodes = 0;
+
+	Offer(vector<_Command>(1, ABORT), best, bestScore);
+	if (!Deadline::Expired()) Plan(planner, iterations, beamWidth, best, bestScore);
+	Improve(best, bestScore);
+
+	if (Deadline::IsLimited()) {
+		for (size_t width = ANYTIME_FIRST_WIDTH; width <= ANYTIME_MAX_WIDTH && !Deadline::Expired(); width *= 4) {
+			int plannedScore = bestScore;
+			Plan(BEAM_PLANNER, iterations, width, best, bestScore);
+			if (bestScore > plannedScore) Improve(best, bestScore);
+		}
+	}
+
+	trace.insert(trace.end(), best.begin(), best.end());
+}
+
+// Description: Runs the planner on the mine and offers the games it has planned
+void Game::Plan(int aplanner, const int & iterations, size_t width, vector<_Command> & best, int & bestScore)
+{
+	// The beam and the tree search play whole games, so they need no order of the lambdas
+	if (aplanner == MCTS_PLANNER) {
+		MctsSolver mcts(this->mine);
+		mcts.SetIterations(mctsIterations);
+		mcts.SetThreads(mctsThreads);
+		mcts.Solve();
+		searchNodes += mcts.GetRollouts();
+		Offer(mcts.GetTrace(), best, bestScore);
+		return;
+	}
+
+	if (aplanner == BEAM_PLANNER) {
+		BeamSolver beam(this->mine);
+		beam.SetWidth(width);
+		beam.SetThreads(beamThreads);
+		beam.Solve();
+		searchNodes += beam.GetExpandedNodes();
+		Offer(beam.GetTrace(), best, bestScore);
+		return;
+	}
+
 	TSPSolver solver(& this->mine);
-	solver.Solve(iterations);
+	solver.Solve(iterations, aplanner == CELL_PLANNER ? tourCandidates : 1);
 
-	Simulator sim(this->mine);
-	sim.StartSimulation(solver.GetNodes());
+	if (aplanner == STATE_PLANNER) {
+		StatePlanner statePlanner(this->mine);
+		statePlanner.StartPlanning(solver.GetNodes());
+		searchNodes += statePlanner.GetExpandedNodes();
+		Offer(statePlanner.GetTrace(), best, bestScore);
+		return;
+	}
+
+	// Every order of the lambdas is simulated, the found tour is offered first and wins ties
+	TourEvaluator evaluator(this->mine);
+	evaluator.SetSnapshotBudget(snapshotBudget);
+	evaluator.SetSafeWalk(walkDistance);
+	evaluator.SetThreads(tourThreads);
+	evaluator.Evaluate(solver.GetCandidates());
+	searchNodes += evaluator.GetExpandedNodes();
 
 	//ofstream fout("..//IO files//output.txt", ios::app);
 
-	vector<IntPair> path = sim.GetPath();
-	BuildPathByCoord(&path);
+	const vector< vector<IntPair> > & paths = evaluator.GetPaths();
+	for (size_t i = 0; i < paths.size(); i++) {
+		vector<_Command> commands;
+		BuildPathByCoord(&paths[i], commands);
+		Offer(commands, best, bestScore);
+	}
 
 	//fout.close();
 }
 
+// Description: Plays the commands on a copy of the game and keeps the best game they give if it
+// scores more than the best trace: the whole one if it ends the game, otherwise the one aborted
+// after the best prefix, so the robot never goes on to die
+void Game::Offer(const vector<_Command> & commands, vector<_Command> & best, int & bestScore)
+{
+	Game game;
+	game.mine = this->mine;
+	int score = MOVE_COST;		// aborting at once
+	size_t length = 0;
+	bool aborted = true;
+
+	for (size_t i = 0; i < commands.size(); i++) {
+		game.MoveRobot(commands[i]);
+		if (game.game_result != 0) {
+			if (game.score > score) {
+				score = game.score;
+				length = game.trace.size();
+				aborted = false;
+			}
+			break;
+		}
+		if (game.score + MOVE_COST + game.lambdas_collected * ABORT_COST > score) {
+			score = game.score + MOVE_COST + game.lambdas_collected * ABORT_COST;
+			length = game.trace.size();
+			aborted = true;
+		}
+	}
+
+	if (score > bestScore) {
+		bestScore = score;
+		best.assign(game.trace.begin(), game.trace.begin() + length);
+		if (aborted) best.push_back(ABORT);
+	}
+}
+
+// Description: Shortens the best trace by TraceOptimizer, which keeps it if nothing scores more
+void Game::Improve(vector<_Command> & best, int & bestScore)
+{
+	TraceOptimizer optimizer(*this);
+	optimizer.SetThreads(traceThreads);
+	optimizer.Optimize(best);
+	if (optimizer.GetScore() > bestScore) {
+		best = optimizer.GetTrace();
+		bestScore = optimizer.GetScore();
+	}
+}
+
+void Game::SetSnapshotBudget(size_t bytes)
+{
+	snapshotBudget = bytes;
+}
+
+void Game::SetSafeWalk(int distance)
+{
+	walkDistance = distance;
+}
+
+void Game::SetPlanner(int aplanner)
+{
+	planner = aplanner;
+}
+
+void Game::SetBeam(size_t width, int threads)
+{
+	beamWidth = width;
+	beamThreads = threads;
+}
+
+void Game::SetMcts(int iterations, int threads)
+{
+	mctsIterations = iterations;
+	mctsThreads = threads;
+}
+
+void Game::SetTours(size_t candidates, int threads)
+{
+	tourCandidates = candidates > 0 ? candidates : 1;
+	tourThreads = threads;
+}
+
+void Game::SetTraceThreads(int threads)
+{
+	traceThreads = threads;
+}
+
+size_t Game::GetSearchNodes()
+{
+	return this->searchNodes;
+}
+
 void Game::MoveRobot(_Command COMMAND)
 {
 	int xold = mine.GetRobot().first;
@@ -99,6 +285,8 @@ void Game::MoveRobot(_Command COMMAND)
 	case DOWN:
 		x++;
 		break;
+	case WAIT:			// the robot stays, but the rocks keep falling
+		break;
 	case ABORT:
 		UpdateScore(false, true);
 		game_result = ABORT_ESCAPE;
@@ -111,7 +299,7 @@ void Game::MoveRobot(_Command COMMAND)
 		return;
 	}
 
-	if (mine.isWalkable((int) x, (int) y)) {
+	if (COMMAND != WAIT && mine.isWalkable((int) x, (int) y)) {
 		// If there is a stone in this cage
 		if (mine.GetObject(x, y) == STONE) {
 			PushStone(COMMAND);
@@ -159,27 +347,27 @@ void Game::UpdateScore(bool lambda_collected, bool escape_by_abort, bool escape_
 }
 
 // Returns trace for the robot, like 'RRRLLLLWLLA'
-void Game::BuildPathByCoord(vector<IntPair> * path)
+void Game::BuildPathByCoord(const vector<IntPair> * path, vector<_Command> & commands)
 {
 	int x = mine.GetRobot().first;
 	int y = mine.GetRobot().second;
 	for (int i = 0; i < (int) path->size(); i++) {
 		if (x - path->at(i).first == 1)
-			trace.push_back(UP);
+			commands.push_back(UP);
 		else if (x - path->at(i).first == -1)
-			trace.push_back(DOWN);
+			commands.push_back(DOWN);
 		else if (y - path->at(i).second == 1)
-			trace.push_back(LEFT);
+			commands.push_back(LEFT);
 		else if (y - path->at(i).second == -1)
-			trace.push_back(RIGHT);
+			commands.push_back(RIGHT);
 		else if (i != (int) path->size() - 1)
-			trace.push_back(WAIT);
+			commands.push_back(WAIT);
 
 		x = path->at(i).first;
 		y = path->at(i).second;
 	}
 
 	if (x != mine.GetLift().first || y != mine.GetLift().second) {
-		trace.push_back(ABORT);
+		commands.push_back(ABORT);
 	}
 }
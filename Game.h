@@ -14,27 +14,58 @@ class Game
 	vector<_Command> trace;
 
 	_GameResult game_result;
+
+	size_t snapshotBudget;		// memory of the field states saved by a robot search
+	int walkDistance;			// the robot search walks safe runs of ways to lambdas at least this far, 0 turns it off
+	int planner;				// CELL_PLANNER, STATE_PLANNER, BEAM_PLANNER or MCTS_PLANNER
+	size_t beamWidth;
+	int beamThreads;
+	int mctsIterations;
+	int mctsThreads;
+	size_t tourCandidates;		// orders of the lambdas simulated by CELL_PLANNER
+	int tourThreads;
+	int traceThreads;			// threads shortening the found trace
+	size_t searchNodes;			// nodes expanded by the planner while solving
 public:
 	Game(void);
 	~Game(void);
+#ifdef HAS_MOVE_SEMANTICS
+	Game(const Game & game) = default;
+	Game(Game && game) = default;
+	Game & operator = (const Game & game) = default;
+	Game & operator = (Game && game) = default;
+#endif
 
 	Field *GetField();
 	int GetScore();
 	int GetMoves();
 	int GetCollectedLambdasNum();
 
-	vector<_Command> GetTrace();
+	const vector<_Command> & GetTrace();
 	_GameResult GetResult();
 	void SetGameResult(_GameResult result);
 
 	int Init(istream &sin);
-	void Solve(const int & iterations);
+	int Init(const char * fileName);	// returns -1 if the file can't be opened
+	void Solve(const int & iterations);	// stops with the best trace found when the Deadline expires
+	void SetSnapshotBudget(size_t bytes);
+	void SetSafeWalk(int distance);		// see Simulator::SetSafeWalk
+	void SetPlanner(int aplanner);
+	void SetBeam(size_t width, int threads);	// width and threads of BEAM_PLANNER, 0 threads use all processors
+	void SetMcts(int iterations, int threads);	// rollouts per command and threads of MCTS_PLANNER
+	void SetTours(size_t candidates, int threads);	// lambda orders and threads simulating them for CELL_PLANNER
+	void SetTraceThreads(int threads);	// threads shortening the found trace, 0 threads use all processors
+	size_t GetSearchNodes();
 
 	void MoveRobot(_Command COMMAND);
 
 private:
+	void Restart();
 	void PushStone(_Command DIRECTION);
 	void UpdateScore(bool lambda_collected = false, bool escape_by_abort = false, bool escape_by_lift = false);
-	void BuildPathByCoord(vector<IntPair> * path);
+	void Plan(int aplanner, const int & iterations, size_t width, vector<_Command> & best, int & bestScore);
+	void Offer(const vector<_Command> & commands, vector<_Command> & best, int & bestScore);
+	void Improve(vector<_Command> & best, int & bestScore);
+	void BuildPathByCoord(const vector<IntPair> * path, vector<_Command> & commands);
 };
 
@@ -0,0 +1,201 @@
+#include "JumpSearch.h"
+
+
+JumpSearch::JumpSearch(void)
+{
+	width = 0;
+	height = 0;
+	passable = SAFE_CELL;
+	expanded = 0;
+}
+
+JumpSearch::~JumpSearch(void)
+{
+}
+
+// Description: Takes kinds of the cells of the field; the lift is an obstacle and rocks are too unless
+// only walls count, then all other cells are safe
+void JumpSearch::Prepare(Field & field, bool wallsOnly)
+{
+	size_t mapHeight = field.GetHeight();
+	size_t mapWidth = field.GetWidth();
+	height = mapHeight + 2;
+	width = mapWidth + 2;
+	kinds.assign(height * width, WALL_CELL);
+	targets.assign(height * width, 0);
+	targetCosts.assign(height * width, -1);
+
+	// Emptying a cell lets the rock above it fall and the rocks next to it or above them slide into it,
+	// so a cell is safe if there are no rocks near it in its row and the row above
+	vector<_MineObject> row(mapWidth);
+	vector<unsigned char> rocksAbove(mapWidth + 2, 0), rocks(mapWidth + 2, 0);
+	for (size_t i = 0; i < mapHeight; i++) {
+		field.GetRow(i, &row[0]);
+		for (size_t j = 0; j < mapWidth; j++)
+			rocks[j + 1] = (row[j] == STONE);
+
+		unsigned char * cell = &kinds[(i + 1) * width + 1];
+		for (size_t j = 0; j < mapWidth; j++) {
+			_MineObject object = row[j];
+			if (!field.GetAnalysis()->IsOpen(i, j)) continue;
+			if (object == CLOSED_LIFT || object == OPENED_LIFT || (object == STONE && !wallsOnly)) {
+				cell[j] = BLOCKED_CELL;
+				continue;
+			}
+			bool nearRock = !wallsOnly && (rocks[j] || rocks[j + 2] || rocksAbove[j] || rocksAbove[j + 1] || rocksAbove[j + 2]);
+			cell[j] = nearRock ? ROCKY_CELL : SAFE_CELL;
+		}
+		rocksAbove.swap(rocks);
+	}
+}
+
+// Description: Finds the shortest way from the start to the target over the prepared field, saving its
+// cells without the start if path isn't NULL
+// Returns: length of the way or -1 if there is none
+int JumpSearch::FindPath(IntPair start, IntPair target, bool safeOnly, vector<IntPair> * path)
+{
+	if (path) path->clear();
+	if (start == target) return 0;
+	if ((size_t) target.first >= height - 2 || (size_t) target.second >= width - 2) return -1;
+	if (kinds[Index(target)] == WALL_CELL) return -1;
+
+	passable = safeOnly ? SAFE_CELL : ROCKY_CELL;
+	if (safeOnly && kinds[Index(start)] != SAFE_CELL) return -1;
+
+	targets[Index(target)] = 1;
+	targetCosts[Index(target)] = -1;
+	Search(start, target, 1);
+	targets[Index(target)] = 0;
+
+	int length = targetCosts[Index(target)];
+	if (length == -1 || !path) return length;
+
+	// Cells between jump points are filled in while going back from the target
+	IntPair ** parent = workspace.GetParents();
+	path->resize(length);
+	IntPair cell(target.first + 1, target.second + 1);
+	for (int k = length - 1; k >= 0; k--) {
+		(*path)[k] = IntPair(cell.first - 1, cell.second - 1);
+		IntPair jumpPoint = parent[cell.first][cell.second];
+		IntPair next = cell;
+		if (next.first != jumpPoint.first) next.first += next.first < jumpPoint.first ? 1 : -1;
+		else next.second += next.second < jumpPoint.second ? 1 : -1;
+		if (next != jumpPoint) parent[next.first][next.second] = jumpPoint;
+		cell = next;
+	}
+	return length;
+}
+
+// Description: Finds lengths of the shortest ways from the start to all the cells by one search,
+// cells near rocks are passed
+void JumpSearch::FindDistances(IntPair start, const vector<IntPair> & cells, vector<int> & distances)
+{
+	passable = ROCKY_CELL;
+
+	int targetsNum = 0;
+	for (size_t i = 0; i < cells.size(); i++) {
+		size_t k = Index(cells[i]);
+		if (!targets[k] && kinds[k] != WALL_CELL && cells[i] != start) {
+			targets[k] = 1;
+			targetCosts[k] = -1;
+			targetsNum++;
+		}
+	}
+	Search(start, IntPair(-1, -1), targetsNum);
+
+	distances.resize(cells.size());
+	for (size_t i = 0; i < cells.size(); i++) {
+		size_t k = Index(cells[i]);
+		distances[i] = cells[i] == start ? 0 : kinds[k] == WALL_CELL ? -1 : targetCosts[k];
+		targets[k] = 0;
+	}
+}
+
+// Description: Closes jump points from the start until the targets are closed; costs of the ways to
+// them are saved in targetCosts, where they are -1 before the search. The single target guides the search
+// by Manhattan distance to it, the search for several ones spreads evenly.
+void JumpSearch::Search(IntPair start, IntPair target, int targetsNum)
+{
+	const int inOpenList = 1, inClosedList = 2;	// lists-related constants
+	const int steps[4] = { -1, 1, -(int) width, (int) width };
+	const bool guided = target.first != -1;
+
+	workspace.Prepare(height, width);
+	SearchMarks & whichList = workspace.GetMarks();		// marks and parents are kept for the cells of the frame
+	IntPair ** parent = workspace.GetParents();
+	OpenList & openList = workspace.GetOpenList();
+
+	int targetX = target.first + 1, targetY = target.second + 1;
+	int startX = start.first + 1, startY = start.second + 1;
+	openList.Push(OpenListItem(startX, startY, 0, guided ? abs(startX - targetX) + abs(startY - targetY) : 0));
+	whichList[startX][startY] = inOpenList;
+
+	// Jumps are straight, so Manhattan distance never overestimates and jump points are never reopened
+	while (!openList.Empty() && targetsNum > 0) {
+		int x = openList.Top().GetX();
+		int y = openList.Top().GetY();
+		int Gcost = openList.Top().GetGcost();
+		openList.Pop();
+		whichList[x][y] = inClosedList;
+		expanded++;
+
+		if (targets[x * width + y]) {
+			targetCosts[x * width + y] = Gcost;
+			if (--targetsNum == 0) break;
+		}
+
+		for (int d = 0; d < 4; d++) {
+			size_t k = x * width + y;
+			if (!Jump(k, steps[d])) continue;
+
+			int jumpX = k / width, jumpY = k % width;
+			if (whichList[jumpX][jumpY] == inClosedList) continue;
+
+			int jumpGcost = Gcost + abs(jumpX - x) + abs(jumpY - y);
+			if (whichList[jumpX][jumpY] != inOpenList) {
+				parent[jumpX][jumpY] = IntPair(x, y);
+				openList.Push(OpenListItem(jumpX, jumpY, jumpGcost, guided ? abs(jumpX - targetX) + abs(jumpY - targetY) : 0));
+				whichList[jumpX][jumpY] = inOpenList;
+			} else {
+				int index = openList.Find(jumpX, jumpY);
+				if (jumpGcost < openList[index].GetGcost()) {
+					parent[jumpX][jumpY] = IntPair(x, y);
+					openList.DecreaseGcost(index, jumpGcost);
+				}
+			}
+		}
+	}
+}
+
+// Description: Returns number of the jump points expanded by all searches
+size_t JumpSearch::GetExpandedNodes()
+{
+	return expanded;
+}
+
+// Description: Moves the cell k by the step to the next jump point
+// Returns: false if the run ends at an obstacle without a jump point
+bool JumpSearch::Jump(size_t & k, int step)
+{
+	// The other axis: up and down for horizontal runs, left and right for vertical ones
+	int side = (step == 1 || step == -1) ? (int) width : 1;
+
+	while (true) {
+		if (!IsPassable(k + step)) return false;
+		k += step;
+
+		if (targets[k] || kinds[k] != SAFE_CELL) return true;
+
+		// A way to a side opens behind an obstacle
+		if ((IsPassable(k - side) && !IsPassable(k - side - step)) || (IsPassable(k + side) && !IsPassable(k + side - step)))
+			return true;
+
+		// A vertical run stops where a run to a side finds a jump point
+		if (side == 1) {
+			size_t sideK = k;
+			if (Jump(sideK, -1)) return true;
+			sideK = k;
+			if (Jump(sideK, 1)) return true;
+		}
+	}
+}
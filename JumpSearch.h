@@ -0,0 +1,50 @@
+#pragma once
+
+#include "stdafx.h"
+#include "Field.h"
+#include "SearchWorkspace.h"
+
+// Shortest ways of the robot over the field as it is now, rocks are obstacles.
+// Runs of safe cells, where the robot can make no rock move, are crossed in one jump which stops only
+// where a way to the side opens behind an obstacle or a run to the side leads to a jump point. Cells
+// near rocks end the jumps, so they are expanded one by one, or are obstacles for safe ways.
+// Kinds of the cells are taken from the field by Prepare, the searches don't look at the field.
+// Distances around walls alone, which only estimate ways as rocks fall or are pushed, jump over rocks too.
+class JumpSearch
+{
+	enum { WALL_CELL, BLOCKED_CELL, ROCKY_CELL, SAFE_CELL };	// BLOCKED_CELL holds a rock or the lift
+
+	size_t width;				// width of the kinds, the map is framed by obstacles
+	size_t height;
+	vector<unsigned char> kinds;	// kind of every cell of the frame
+	vector<unsigned char> targets;	// 1 for the targets of the current search, which are passable and stop jumps
+	vector<int> targetCosts;	// lengths of the ways to the targets closed by the current search
+	unsigned char passable;		// the lowest kind of the cells the way may pass
+	SearchWorkspace workspace;	// memory of the search, allocated once for the map
+	size_t expanded;			// jump points expanded by all searches
+
+public:
+	JumpSearch(void);
+	~JumpSearch(void);
+
+	void Prepare(Field & field, bool wallsOnly = false);	// takes kinds of the cells, only walls and the lift are obstacles if wallsOnly
+	int FindPath(IntPair start, IntPair target, bool safeOnly, vector<IntPair> * path);
+	void FindDistances(IntPair start, const vector<IntPair> & cells, vector<int> & distances);	// -1 for unreachable cells
+	size_t GetExpandedNodes();
+	bool IsSafe(IntPair cell)			// no rock moves when the robot leaves the cell
+	{
+		return kinds[Index(cell)] == SAFE_CELL;
+	}
+
+private:
+	size_t Index(IntPair cell)
+	{
+		return (cell.first + 1) * width + cell.second + 1;
+	}
+	bool IsPassable(size_t k)
+	{
+		return kinds[k] >= passable || targets[k];
+	}
+	void Search(IntPair start, IntPair target, int targetsNum);
+	bool Jump(size_t & k, int step);
+};
@@ -0,0 +1,221 @@
+#include "LambdaSet.h"
+
+
+LambdaSet::LambdaSet(void)
+{
+	width = 0;
+	height = 0;
+}
+
+LambdaSet::LambdaSet(const LambdaSet & set)
+{
+	width = set.width;
+	height = set.height;
+	items = set.items;
+	bands = set.bands;
+	RetainBands();
+}
+
+#ifdef HAS_MOVE_SEMANTICS
+// Description: Takes the list and the index, the other set becomes empty
+LambdaSet::LambdaSet(LambdaSet && set)
+{
+	width = set.width;
+	height = set.height;
+	items = std::move(set.items);
+	bands = std::move(set.bands);
+	set.items.clear();
+	set.bands.clear();
+}
+#endif
+
+LambdaSet::~LambdaSet(void)
+{
+	ReleaseBands();
+}
+
+void LambdaSet::Reset(size_t aheight, size_t awidth)
+{
+	ReleaseBands();
+	items.clear();
+	width = awidth;
+	height = aheight;
+	bands.assign((height + FIELD_TILE_ROWS - 1) / FIELD_TILE_ROWS, (SlotBand *) NULL);
+}
+
+// Description: Empties the list; shared bands are dropped, private ones are cleared
+void LambdaSet::Clear()
+{
+	for (size_t i = 0; i < items.size(); i++) {
+		if (!IsInMap(items[i])) continue;
+		SlotBand *& band = bands[items[i].first / FIELD_TILE_ROWS];
+		if (!band) continue;
+		if (IsShared(band)) {
+			ReleaseBand(band);
+			band = NULL;
+		} else {
+			band->slots[(items[i].first % FIELD_TILE_ROWS) * width + items[i].second] = 0;
+		}
+	}
+	items.clear();
+}
+
+bool LambdaSet::Add(IntPair lambda)
+{
+	if (Find(lambda) != -1) return false;
+
+	items.push_back(lambda);
+	SetSlot(lambda, items.size());
+	return true;
+}
+
+void LambdaSet::PopBack()
+{
+	SetSlot(items.back(), 0);
+	items.pop_back();
+}
+
+int LambdaSet::Erase(IntPair lambda)
+{
+	int index = Find(lambda);
+	if (index == -1) return -1;
+
+	IntPair last = items.back();
+	items[index] = last;
+	items.pop_back();
+	SetSlot(last, index + 1);
+	SetSlot(lambda, 0);
+	return index;
+}
+
+// Description: Puts lambda into the slot and moves the lambda of the slot to the end of the list
+void LambdaSet::Insert(size_t index, IntPair lambda)
+{
+	if (index == items.size()) {
+		Add(lambda);
+		return;
+	}
+
+	IntPair moved = items[index];
+	items.push_back(moved);
+	items[index] = lambda;
+	SetSlot(moved, items.size());
+	SetSlot(lambda, index + 1);
+}
+
+int LambdaSet::Find(IntPair lambda)
+{
+	if (IsInMap(lambda)) {
+		SlotBand * band = bands[lambda.first / FIELD_TILE_ROWS];
+		return band ? band->slots[(lambda.first % FIELD_TILE_ROWS) * width + lambda.second] - 1 : -1;
+	}
+
+	// Cells out of the map have no slots, they are looked up in the list
+	for (size_t i = 0; i < items.size(); i++)
+		if (items[i] == lambda) return i;
+	return -1;
+}
+
+// Description: Counts the list and the bands the origin doesn't share
+size_t LambdaSet::GetBytesApartFrom(LambdaSet * origin)
+{
+	size_t bytes = items.size() * sizeof(IntPair);
+	for (size_t i = 0; i < bands.size(); i++) {
+		if (bands[i] && (!origin || i >= origin->bands.size() || origin->bands[i] != bands[i]))
+			bytes += sizeof(SlotBand) + FIELD_TILE_ROWS * width * sizeof(int);
+	}
+	return bytes;
+}
+
+LambdaSet & LambdaSet::operator = (const LambdaSet & set)
+{
+	if (this == &set) return *this;
+
+	vector<SlotBand *> old;
+	old.swap(bands);
+	bands = set.bands;
+	RetainBands();
+	for (size_t i = 0; i < old.size(); i++)
+		ReleaseBand(old[i]);
+
+	width = set.width;
+	height = set.height;
+	items = set.items;
+	return *this;
+}
+
+#ifdef HAS_MOVE_SEMANTICS
+LambdaSet & LambdaSet::operator = (LambdaSet && set)
+{
+	if (this == &set) return *this;
+
+	ReleaseBands();
+	width = set.width;
+	height = set.height;
+	items = std::move(set.items);
+	bands = std::move(set.bands);
+	set.items.clear();
+	set.bands.clear();
+	return *this;
+}
+#endif
+
+bool LambdaSet::IsInMap(IntPair lambda)
+{
+	return lambda.first >= 0 && lambda.second >= 0 && (size_t) lambda.first < height && (size_t) lambda.second < width;
+}
+
+void LambdaSet::SetSlot(IntPair cell, int slot)
+{
+	if (!IsInMap(cell)) return;
+	// Clearing a slot of a band which isn't allocated changes nothing
+	if (slot == 0 && !bands[cell.first / FIELD_TILE_ROWS]) return;
+	MutableSlots(cell.first)[(cell.first % FIELD_TILE_ROWS) * width + cell.second] = slot;
+}
+
+int * LambdaSet::MutableSlots(size_t x)
+{
+	SlotBand *& band = bands[x / FIELD_TILE_ROWS];
+	size_t size = FIELD_TILE_ROWS * width;
+	if (!band) {
+		band = new SlotBand;
+		band->refs = 1;
+		band->slots = new int [size];
+		memset(band->slots, 0, size * sizeof(int));
+	} else if (IsShared(band)) {
+		SlotBand * copy = new SlotBand;
+		copy->refs = 1;
+		copy->slots = new int [size];
+		memcpy(copy->slots, band->slots, size * sizeof(int));
+		ReleaseBand(band);
+		band = copy;
+	}
+	return band->slots;
+}
+
+// Reference counters are changed and read atomically, so copies sharing bands may live in different threads
+void LambdaSet::RetainBands()
+{
+	for (size_t i = 0; i < bands.size(); i++)
+		if (bands[i]) __sync_fetch_and_add(&bands[i]->refs, 1);
+}
+
+void LambdaSet::ReleaseBands()
+{
+	for (size_t i = 0; i < bands.size(); i++)
+		ReleaseBand(bands[i]);
+	bands.clear();
+}
+
+bool LambdaSet::IsShared(SlotBand * band)
+{
+	return __sync_fetch_and_add(&band->refs, 0) > 1;
+}
+
+void LambdaSet::ReleaseBand(SlotBand * band)
+{
+	if (band && __sync_sub_and_fetch(&band->refs, 1) == 0) {
+		delete [] band->slots;
+		delete band;
+	}
+}
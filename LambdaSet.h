@@ -0,0 +1,61 @@
+#pragma once
+
+#include "stdafx.h"
+
+// List of lambda cells with a slot index for every cell of the map.
+// Membership, lookup and removal take constant time; a lambda is removed by moving the
+// last one into its slot. The index is cut into bands of FIELD_TILE_ROWS rows shared by copies
+// like FieldTile, so a copy which picks up a lambda clones only the band of that lambda; bands
+// without lambdas aren't allocated. Every cell is kept in the list once.
+class LambdaSet
+{
+	// Slot index of FIELD_TILE_ROWS map rows
+	struct SlotBand
+	{
+		int refs;
+		int * slots;		// position + 1 of the lambda in the list, 0 for cells without lambda
+	};
+
+	size_t width;
+	size_t height;
+	vector<IntPair> items;
+	vector<SlotBand *> bands;	// NULL for bands without slots
+
+public:
+	LambdaSet(void);
+	LambdaSet(const LambdaSet & set);
+#ifdef HAS_MOVE_SEMANTICS
+	LambdaSet(LambdaSet && set);
+#endif
+	~LambdaSet(void);
+
+	void Reset(size_t aheight, size_t awidth);	// makes the list empty and resizes the index to the map
+	void Clear();
+
+	bool Add(IntPair lambda);			// appends lambda, returns false if it is in the list already
+	void PopBack();
+	int Erase(IntPair lambda);			// moves the last lambda into the slot, returns the slot or -1
+	void Insert(size_t index, IntPair lambda);	// undoes Erase: puts lambda back into the slot
+	int Find(IntPair lambda);			// returns position of lambda in the list or -1
+
+	size_t Size() { return items.size(); }
+	bool Empty() { return items.empty(); }
+	IntPair At(size_t index) { return items[index]; }
+	IntPair Back() { return items.back(); }
+	const vector<IntPair> & GetItems() { return items; }
+	size_t GetBytesApartFrom(LambdaSet * origin);	// estimates memory not shared with the origin
+
+	LambdaSet & operator = (const LambdaSet & set);
+#ifdef HAS_MOVE_SEMANTICS
+	LambdaSet & operator = (LambdaSet && set);
+#endif
+
+private:
+	bool IsInMap(IntPair lambda);
+	void SetSlot(IntPair cell, int slot);	// cells out of the map have no slots and are looked up in the list
+	int * MutableSlots(size_t x);	// makes the band of the row private before writing into it
+	void RetainBands();
+	void ReleaseBands();
+	static bool IsShared(SlotBand * band);
+	static void ReleaseBand(SlotBand * band);
+};
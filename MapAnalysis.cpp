@@ -0,0 +1,235 @@
+#include "MapAnalysis.h"
+#include "Field.h"
+
+
+MapAnalysis::MapAnalysis(Field & field)
+{
+	refs = 1;
+	height = field.GetHeight();
+	width = field.GetWidth();
+
+	open.assign(height * width, 0);
+	for (size_t i = 0; i < height; i++) {
+		for (size_t j = 0; j < width; j++) {
+			open[i * width + j] = (field.GetObject(i, j) != WALL);
+		}
+	}
+
+	// Neighbours are listed in the order the searches used to scan them
+	const int dx[4] = { -1, 0, 0, 1 };
+	const int dy[4] = { 0, -1, 1, 0 };
+	neighbourStart.assign(height * width + 1, 0);
+	for (size_t i = 0; i < height; i++) {
+		for (size_t j = 0; j < width; j++) {
+			neighbourStart[i * width + j] = neighbours.size();
+			if (!open[i * width + j]) continue;
+			for (int d = 0; d < 4; d++) {
+				if (IsOpen(i + dx[d], j + dy[d]))
+					neighbours.push_back(IntPair(i + dx[d], j + dy[d]));
+			}
+		}
+	}
+	neighbourStart[height * width] = neighbours.size();
+
+	FindComponents(field);
+	FindTrappedLambdas(field);
+}
+
+MapAnalysis::~MapAnalysis(void)
+{
+}
+
+void MapAnalysis::Retain()
+{
+	__sync_fetch_and_add(&refs, 1);
+}
+
+void MapAnalysis::Release()
+{
+	if (__sync_sub_and_fetch(&refs, 1) == 0)
+		delete this;
+}
+
+const IntPair * MapAnalysis::GetNeighbours(int x, int y, int & count)
+{
+	size_t k = x * width + y;
+	count = neighbourStart[k + 1] - neighbourStart[k];
+	return neighbours.empty() ? NULL : &neighbours[0] + neighbourStart[k];
+}
+
+int MapAnalysis::GetComponent(int x, int y)
+{
+	if (!IsOpen(x, y)) return -1;
+	return components[x * width + y];
+}
+
+int MapAnalysis::GetComponentsNum()
+{
+	return componentsNum;
+}
+
+bool MapAnalysis::IsLambdaReachable(IntPair lambda)
+{
+	return robotComponent == -1 || reached[lambda.first * width + lambda.second];
+}
+
+const vector<IntPair> & MapAnalysis::GetUnreachableLambdas()
+{
+	return unreachableLambdas;
+}
+
+// Description: Labels components of the open cells by flood fill and finds the robot's one
+//
+// The lift is not a part of any component: it opens only when all lambdas are collected and the game
+// ends when the robot enters it, so lambdas behind the lift can't be collected.
+void MapAnalysis::FindComponents(Field & field)
+{
+	components.assign(height * width, -1);
+	componentsNum = 0;
+
+	IntPair lift = field.GetLift();
+	vector<IntPair> queue;
+	for (size_t i = 0; i < height; i++) {
+		for (size_t j = 0; j < width; j++) {
+			if (!open[i * width + j] || components[i * width + j] != -1) continue;
+			if ((int) i == lift.first && (int) j == lift.second) continue;
+
+			components[i * width + j] = componentsNum;
+			queue.clear();
+			queue.push_back(IntPair(i, j));
+			for (size_t head = 0; head < queue.size(); head++) {
+				int count;
+				const IntPair * next = GetNeighbours(queue[head].first, queue[head].second, count);
+				for (int k = 0; k < count; k++) {
+					int & component = components[next[k].first * width + next[k].second];
+					if (component != -1 || next[k] == lift) continue;
+					component = componentsNum;
+					queue.push_back(next[k]);
+				}
+			}
+			componentsNum++;
+		}
+	}
+
+	// Without a robot on the map nothing can be said about lambdas
+	robotComponent = GetComponent(field.GetRobot().first, field.GetRobot().second);
+}
+
+// Description: Checks whether the cell is out of the map or is marked as solid
+bool MapAnalysis::IsSolid(int x, int y, vector<unsigned char> & solid)
+{
+	return (size_t) x >= height || (size_t) y >= width || solid[x * width + y];
+}
+
+// Description: Checks whether the rock can never fall, slide or be pushed while solid cells stay solid
+bool MapAnalysis::IsFixedRock(Field & field, int x, int y, vector<unsigned char> & solid)
+{
+	if (!IsSolid(x + 1, y, solid)) return false;
+
+	// The robot pushes a rock from one side into the empty cell on the other side
+	if (!IsSolid(x, y - 1, solid) && !IsSolid(x, y + 1, solid)) return false;
+
+	_MineObject below = field.GetObject(x + 1, y);
+	bool slidesRight = !IsSolid(x, y + 1, solid) && !IsSolid(x + 1, y + 1, solid);
+	bool slidesLeft = !IsSolid(x, y - 1, solid) && !IsSolid(x + 1, y - 1, solid);
+	if (below == STONE) return !slidesRight && !slidesLeft;
+	if (below == LAMBDA) return !slidesRight;
+	return true;
+}
+
+// Description: Checks whether the rock can't move before the robot enters the earth or the lambda below it
+bool MapAnalysis::IsPinnedRock(Field & field, int x, int y, vector<unsigned char> & solid)
+{
+	_MineObject below = field.GetObject(x + 1, y);
+	if (below != EARTH && below != LAMBDA) return false;
+	if (!IsSolid(x, y - 1, solid) && !IsSolid(x, y + 1, solid)) return false;
+	return below == EARTH || IsSolid(x, y + 1, solid) || IsSolid(x + 1, y + 1, solid);
+}
+
+// Description: Checks whether the robot may enter the cell from the cells reached so far
+bool MapAnalysis::CanEnter(Field & field, int x, int y, vector<unsigned char> & solid)
+{
+	if (!IsOpen(x, y) || reached[x * width + y]) return false;
+
+	// Earth and lambdas are solid only until the robot reaches them
+	_MineObject object = field.GetObject(x, y);
+	if (object != EARTH && object != LAMBDA && solid[x * width + y]) return false;
+
+	// A pinned rock lets the robot in only after the cell below it is reached
+	if (object == STONE && IsPinnedRock(field, x, y, solid)) return reached[(x + 1) * width + y] != 0;
+
+	int count;
+	const IntPair * next = GetNeighbours(x, y, count);
+	for (int n = 0; n < count; n++) {
+		if (reached[next[n].first * width + next[n].second]) return true;
+	}
+	return false;
+}
+
+// Description: Finds cells the robot may ever enter and lambdas it can never collect
+//
+// Solid cells never become empty and the robot never enters them: walls, the lift, rocks which never
+// move and earth or lambdas the robot never reaches. At first all earth, lambdas and rocks are solid.
+// A rock which may move while the solid cells stay solid is dropped, and the flood from the robot's
+// position enters earth, lambdas and cells which are not solid; a pinned rock stops the flood until
+// the cell below it is reached. Whether a rock is fixed or a cell may be entered depends only on the
+// cells around it, so when a cell is reached or stops being solid only its neighbours are checked
+// again. Nothing becomes solid again, so every cell is reached and every rock is dropped at most
+// once. A lambda in a shaft under a rock is never reached:
+//
+// #*#
+// #\#
+// ###
+void MapAnalysis::FindTrappedLambdas(Field & field)
+{
+	reached.assign(height * width, 1);
+	if (robotComponent == -1) return;
+
+	IntPair lift = field.GetLift();
+	vector<unsigned char> solid(height * width, 0);
+	for (size_t i = 0; i < height; i++) {
+		for (size_t j = 0; j < width; j++) {
+			_MineObject object = field.GetObject(i, j);
+			solid[i * width + j] = !open[i * width + j] || object == EARTH || object == LAMBDA || object == STONE;
+		}
+	}
+	if (IsOpen(lift.first, lift.second)) solid[lift.first * width + lift.second] = 1;
+
+	reached.assign(height * width, 0);
+	vector<IntPair> changed;			// cells which have been reached or have stopped being solid
+	changed.push_back(field.GetRobot());
+	reached[changed[0].first * width + changed[0].second] = 1;
+	for (size_t i = 0; i < height; i++) {
+		for (size_t j = 0; j < width; j++) {
+			if (field.GetObject(i, j) == STONE && !IsFixedRock(field, i, j, solid)) {
+				solid[i * width + j] = 0;
+				changed.push_back(IntPair(i, j));
+			}
+		}
+	}
+
+	while (!changed.empty()) {
+		IntPair cell = changed.back();
+		changed.pop_back();
+		for (int x = cell.first - 1; x <= cell.first + 1; x++) {
+			for (int y = cell.second - 1; y <= cell.second + 1; y++) {
+				size_t k = x * width + y;
+				if (!IsOpen(x, y) || reached[k]) continue;
+				if (solid[k] && field.GetObject(x, y) == STONE) {
+					if (IsFixedRock(field, x, y, solid)) continue;
+				} else {
+					if (!CanEnter(field, x, y, solid)) continue;
+					reached[k] = 1;
+				}
+				solid[k] = 0;
+				changed.push_back(IntPair(x, y));
+			}
+		}
+	}
+
+	const vector<IntPair> & lambdas = field.GetLambdas();
+	for (size_t i = 0; i < lambdas.size(); i++) {
+		if (!reached[lambdas[i].first * width + lambdas[i].second])
+			unreachableLambdas.push_back(lambdas[i]);
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "stdafx.h"
+
+class Field;
+
+// Facts about the map which never change because walls never change: which cells are not walls,
+// their neighbours and the components of cells connected without passing walls or the lift.
+// Besides, it finds cells the robot can never reach because of rocks which can never move.
+// It is made once when the map is loaded and is shared by all copies of the Field.
+class MapAnalysis
+{
+	int refs;				// number of Fields holding the analysis
+	size_t width;
+	size_t height;
+
+	vector<unsigned char> open;		// 1 for cells which are not walls
+	vector<int> neighbourStart;		// neighbours of the cell k are neighbours[neighbourStart[k]..neighbourStart[k + 1])
+	vector<IntPair> neighbours;		// open neighbours in the order up, left, right, down
+	vector<int> components;			// component of every open cell except the lift, -1 for others
+	int componentsNum;
+	int robotComponent;				// component of the robot at load time, -1 if there is no robot
+	vector<unsigned char> reached;	// 1 for cells the robot may ever enter, all 1 if there is no robot
+	vector<IntPair> unreachableLambdas;	// lambdas the robot can never enter
+
+public:
+	MapAnalysis(Field & field);
+
+	void Retain();
+	void Release();							// deletes the analysis when nobody holds it
+
+	bool IsOpen(int x, int y)				// checks whether the cell is on the map and is not a wall
+	{
+		return (size_t) x < height && (size_t) y < width && open[x * width + y];
+	}
+	const IntPair * GetNeighbours(int x, int y, int & count);	// returns open neighbours of the open cell
+	int GetComponent(int x, int y);
+	int GetComponentsNum();
+	bool IsLambdaReachable(IntPair lambda);	// returns false if the robot can never enter the lambda's cell
+	const vector<IntPair> & GetUnreachableLambdas();
+
+private:
+	~MapAnalysis(void);
+	void FindComponents(Field & field);
+	void FindTrappedLambdas(Field & field);
+	bool IsSolid(int x, int y, vector<unsigned char> & solid);
+	bool IsFixedRock(Field & field, int x, int y, vector<unsigned char> & solid);
+	bool IsPinnedRock(Field & field, int x, int y, vector<unsigned char> & solid);
+	bool CanEnter(Field & field, int x, int y, vector<unsigned char> & solid);
+};
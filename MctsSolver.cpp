@@ -0,0 +1,392 @@
+#include "MctsSolver.h"
+#include "StatePlanner.h"
+#include "Deadline.h"
+#include "DangerMap.h"
+#include <unistd.h>
+#include <limits.h>
+
+// Commands in the order of the children of the nodes
+static const _Command treeCommands[] = { UP, LEFT, RIGHT, DOWN, WAIT };
+
+MctsSolver::MctsSolver(Field & amine)
+{
+	this->mine = amine;
+	score = 0;
+	lambdas = 0;
+	measuredLambdas = (size_t) -1;
+	iterations = MCTS_ITERATIONS;
+	threadsNum = MCTS_THREADS;
+	rollouts = 0;
+}
+
+MctsSolver::~MctsSolver(void)
+{
+}
+
+void MctsSolver::SetIterations(int aiterations)
+{
+	iterations = aiterations > 0 ? aiterations : 1;
+}
+
+void MctsSolver::SetThreads(int threads)
+{
+	threadsNum = threads;
+}
+
+const vector<_Command> & MctsSolver::GetTrace()
+{
+	return this->trace;
+}
+
+size_t MctsSolver::GetRollouts()
+{
+	return this->rollouts;
+}
+
+// Description: Plays the game command by command until the robot escapes, no command is left,
+// the game lasts as many moves as the map has cells or MCTS_STALL_MOVES commands don't find a better game
+void MctsSolver::Solve()
+{
+	int threads = threadsNum;
+	if (threads <= 0) threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads <= 0) threads = 1;
+
+	vector<_Command> played;
+	vector<_Command> best(1, ABORT);	// aborting at once is the worst game
+	int bestScore = AbortScore(0, 0);
+	int maxMoves = mine.GetWidth() * mine.GetHeight();
+	int stall = 0;
+	measuredLambdas = (size_t) -1;
+
+	while ((int) played.size() < maxMoves && stall < MCTS_STALL_MOVES && !Deadline::Expired()) {
+		if (mine.GetLambdasNum() != measuredLambdas) MeasureDistances();
+
+		vector<Worker> workers(threads);
+		vector<pthread_t> handles(threads);
+		for (int i = 0; i < threads; i++) {
+			workers[i].solver = this;
+			workers[i].random = (played.size() + 1) * 0x9E3779B97F4A7C15ULL ^ (i + 1) * 0xBF58476D1CE4E5B9ULL;
+			workers[i].rollouts = 0;
+			workers[i].bestScore = INT_MIN;
+		}
+		for (int i = 1; i < threads; i++)
+			pthread_create(&handles[i], NULL, Search, &workers[i]);
+		GrowTree(workers[0]);
+		for (int i = 1; i < threads; i++)
+			pthread_join(handles[i], NULL);
+
+		// Trees are merged by summing the visits of the commands at the root
+		bool improved = false;
+		int visits[5] = { 0, 0, 0, 0, 0 };
+		for (int i = 0; i < threads; i++) {
+			rollouts += workers[i].rollouts;
+			if (workers[i].bestScore > bestScore) {
+				bestScore = workers[i].bestScore;
+				best = played;
+				best.insert(best.end(), workers[i].bestCommands.begin(), workers[i].bestCommands.end());
+				improved = true;
+			}
+
+			Node & root = workers[i].nodes[0];
+			for (int k = 0; k < 5; k++) {
+				int child = root.children[k];
+				// Commands killing the robot are never played
+				if (child >= 0 && workers[i].nodes[child].field) visits[k] += workers[i].nodes[child].visits;
+			}
+			ReleaseTree(workers[i]);
+		}
+
+		int command = -1;
+		for (int k = 0; k < 5; k++) {
+			if (visits[k] > 0 && (command == -1 || visits[k] > visits[command])) command = k;
+		}
+		if (command == -1) break;
+
+		size_t lambdasNum = mine.GetLambdasNum();
+		StatePlanner::MoveRobot(mine, treeCommands[command]);
+		played.push_back(treeCommands[command]);
+		lambdas += (int) (lambdasNum - mine.GetLambdasNum());
+		score += MOVE_COST + (int) (lambdasNum - mine.GetLambdasNum()) * LAMBDA_COST;
+
+		// Trees only meet games longer than the played one, so its own end is checked here
+		if (mine.GetRobot() == mine.GetLift()) {
+			score += lambdas * LIFT_COST;
+			if (score > bestScore) {
+				bestScore = score;
+				best = played;
+			}
+			break;
+		}
+		if (AbortScore(score, lambdas) > bestScore) {
+			bestScore = AbortScore(score, lambdas);
+			best = played;
+			best.push_back(ABORT);
+			improved = true;
+		}
+
+		stall = improved ? 0 : stall + 1;
+	}
+
+	trace = best;
+}
+
+void * MctsSolver::Search(void * worker)
+{
+	Worker * tree = (Worker *) worker;
+	tree->solver->GrowTree(*tree);
+	return NULL;
+}
+
+// Description: Makes the iterations of the search from the current state in the tree of the worker;
+// only the Fields of the tree are written, so the trees are grown in parallel
+void MctsSolver::GrowTree(Worker & worker)
+{
+	FieldArena arena;	// tiles of the Fields made by the thread
+
+	Node root;
+	root.parent = -1;
+	root.command = WAIT;
+	for (int k = 0; k < 5; k++)
+		root.children[k] = -1;
+	root.tried = 0;
+	root.visits = 0;
+	root.total = 0;
+	root.field = new Field(mine);
+	root.score = score;
+	root.lambdas = lambdas;
+	root.terminal = false;
+	worker.nodes.push_back(root);
+
+	for (int i = 0; i < iterations && !Deadline::Expired(); i++) {
+		// Selection goes down while all commands of the node are tried, then one child is added
+		int node = 0;
+		while (!worker.nodes[node].terminal) {
+			if (worker.nodes[node].tried < 5) {
+				int child = AddChild(worker, node, worker.nodes[node].tried++);
+				if (child == -2) continue;
+				node = child;
+				break;
+			}
+			int next = Select(worker, node);
+			if (next == -1) break;
+			node = next;
+		}
+
+		double value = Rollout(worker, node);
+		worker.rollouts++;
+
+		for (int k = node; k != -1; k = worker.nodes[k].parent) {
+			worker.nodes[k].visits++;
+			worker.nodes[k].total += value;
+		}
+	}
+}
+
+// Description: Returns the child with the best upper confidence bound or -1 if the robot can't move
+int MctsSolver::Select(Worker & worker, int node)
+{
+	// Values are scaled to the score of one more lambda collected before aborting
+	const double scale = LAMBDA_COST + ABORT_COST;
+	double logVisits = log((double) worker.nodes[node].visits + 1);
+
+	int result = -1;
+	double bestBound = 0;
+	for (int k = 0; k < 5; k++) {
+		int child = worker.nodes[node].children[k];
+		if (child < 0) continue;
+		Node & item = worker.nodes[child];
+		double bound = item.total / item.visits / scale + MCTS_EXPLORATION * sqrt(logVisits / item.visits);
+		if (result == -1 || bound > bestBound) {
+			result = child;
+			bestBound = bound;
+		}
+	}
+	return result;
+}
+
+// Description: Makes the command on a copy of the node's state
+// Returns: the new node or -2 if the robot can't make the command
+int MctsSolver::AddChild(Worker & worker, int node, int command)
+{
+	Field * field = new Field(*worker.nodes[node].field);
+	if (!StatePlanner::MoveRobot(*field, treeCommands[command]) && !field->IsRobotDead()) {
+		delete field;
+		worker.nodes[node].children[command] = -2;
+		return -2;
+	}
+
+	Node & parent = worker.nodes[node];
+	Node child;
+	child.parent = node;
+	child.command = treeCommands[command];
+	for (int k = 0; k < 5; k++)
+		child.children[k] = -1;
+	child.tried = 0;
+	child.visits = 0;
+	child.total = 0;
+	child.field = field;
+	child.lambdas = parent.lambdas + (int) (parent.field->GetLambdasNum() - field->GetLambdasNum());
+	child.score = parent.score + MOVE_COST + (child.lambdas - parent.lambdas) * LAMBDA_COST;
+	child.terminal = field->IsRobotDead() || field->GetRobot() == field->GetLift();
+	if (field->IsRobotDead()) {
+		// The game ends with the score it has
+		delete field;
+		child.field = NULL;
+	} else if (child.terminal) {
+		child.score += child.lambdas * LIFT_COST;
+	}
+
+	parent.children[command] = worker.nodes.size();
+	worker.nodes.push_back(child);
+	return worker.nodes.size() - 1;
+}
+
+// Description: Plays MCTS_ROLLOUT_DEPTH commands from the node, heading for the nearest lambda or
+// the opened lift in MCTS_GREEDY_PERCENT of them and taking a random one otherwise
+// Returns: the best score of escaping or aborting on the way
+int MctsSolver::Rollout(Worker & worker, int node)
+{
+	Node & start = worker.nodes[node];
+	vector<_Command> played;
+	if (start.terminal) {
+		if (start.field) Remember(worker, node, played, start.score);	// the robot has escaped
+		return start.score;
+	}
+
+	Field field(*start.field);
+	int gameScore = start.score, gameLambdas = start.lambdas;
+	int value = AbortScore(gameScore, gameLambdas);
+	size_t bestLength = 0;
+	bool escaped = false;
+
+	for (int d = 0; d < MCTS_ROLLOUT_DEPTH; d++) {
+		// Commands the robot can make, waiting is always possible
+		IntPair robot = field.GetRobot();
+		const IntPair cells[] = { IntPair(robot.first - 1, robot.second), IntPair(robot.first, robot.second - 1),
+			IntPair(robot.first, robot.second + 1), IntPair(robot.first + 1, robot.second), robot };
+		int possible[5], possibleNum = 0;
+		for (int k = 0; k < 5; k++) {
+			if (k == 4 || field.isWalkable(cells[k].first, cells[k].second)) possible[possibleNum++] = k;
+		}
+
+		int command = possible[NextRandom(worker.random) % possibleNum];
+		if ((int) (NextRandom(worker.random) % 100) < MCTS_GREEDY_PERCENT) {
+			int bestDistance = INT_MAX;
+			for (int k = 0; k < possibleNum; k++) {
+				int distance = Distance(field, cells[possible[k]]);
+				if (distance < bestDistance) {
+					bestDistance = distance;
+					command = possible[k];
+				}
+			}
+		}
+
+		// The game ends with the death, which adds nothing to the value, so the command isn't made
+		if (DangerMap::IsLethalMove(field, treeCommands[command])) break;
+
+		size_t lambdasNum = field.GetLambdasNum();
+		bool alive = StatePlanner::MoveRobot(field, treeCommands[command]);
+		played.push_back(treeCommands[command]);
+		gameLambdas += (int) (lambdasNum - field.GetLambdasNum());
+		gameScore += MOVE_COST + (int) (lambdasNum - field.GetLambdasNum()) * LAMBDA_COST;
+		if (!alive) break;
+
+		if (field.GetRobot() == field.GetLift()) {
+			gameScore += gameLambdas * LIFT_COST;
+			if (gameScore > value) {
+				value = gameScore;
+				bestLength = played.size();
+				escaped = true;
+			}
+			break;
+		}
+		if (AbortScore(gameScore, gameLambdas) > value) {
+			value = AbortScore(gameScore, gameLambdas);
+			bestLength = played.size();
+		}
+	}
+
+	if (value > worker.bestScore) {
+		played.resize(bestLength);
+		if (!escaped) played.push_back(ABORT);
+		Remember(worker, node, played, value);
+	}
+	return value;
+}
+
+// Description: Keeps the game of the worker: commands from the root to the node and then the given ones
+void MctsSolver::Remember(Worker & worker, int node, const vector<_Command> & commands, int value)
+{
+	if (value <= worker.bestScore) return;
+
+	worker.bestScore = value;
+	worker.bestCommands.clear();
+	for (int k = node; worker.nodes[k].parent != -1; k = worker.nodes[k].parent)
+		worker.bestCommands.push_back(worker.nodes[k].command);
+	reverse(worker.bestCommands.begin(), worker.bestCommands.end());
+	worker.bestCommands.insert(worker.bestCommands.end(), commands.begin(), commands.end());
+}
+
+void MctsSolver::ReleaseTree(Worker & worker)
+{
+	for (size_t i = 0; i < worker.nodes.size(); i++)
+		delete worker.nodes[i].field;
+	worker.nodes.clear();
+}
+
+int MctsSolver::AbortScore(int score, int lambdas)
+{
+	return score + MOVE_COST + lambdas * ABORT_COST;
+}
+
+// Description: Measures by breadth-first search how far every open cell is from the lambdas left,
+// or from the lift when all are collected. Rocks are ignored, so rollouts aren't led into walls
+void MctsSolver::MeasureDistances()
+{
+	MapAnalysis * analysis = mine.GetAnalysis();
+	int width = mine.GetWidth();
+	distances.assign(width * mine.GetHeight(), INT_MAX);
+	measuredLambdas = mine.GetLambdasNum();
+
+	vector<IntPair> queue;
+	if (measuredLambdas == 0) queue.push_back(mine.GetLift());
+	else queue = mine.GetLambdas();
+	for (size_t i = 0; i < queue.size(); i++)
+		distances[queue[i].first * width + queue[i].second] = 0;
+
+	for (size_t head = 0; head < queue.size(); head++) {
+		int count;
+		const IntPair * next = analysis->GetNeighbours(queue[head].first, queue[head].second, count);
+		int distance = distances[queue[head].first * width + queue[head].second] + 1;
+		for (int k = 0; k < count; k++) {
+			int & cell = distances[next[k].first * width + next[k].second];
+			if (cell != INT_MAX) continue;
+			cell = distance;
+			queue.push_back(next[k]);
+		}
+	}
+}
+
+// Description: Walking distance while the lambdas of the measured state are left, and the straight
+// one after the rollout has collected some of them
+int MctsSolver::Distance(Field & field, IntPair cell)
+{
+	if (field.GetLambdasNum() == measuredLambdas) return distances[cell.first * mine.GetWidth() + cell.second];
+	if (field.GetLambdasNum() == 0)
+		return abs(cell.first - field.GetLift().first) + abs(cell.second - field.GetLift().second);
+
+	const vector<IntPair> & lambdas = field.GetLambdas();
+	int distance = INT_MAX;
+	for (size_t i = 0; i < lambdas.size(); i++)
+		distance = min(distance, abs(cell.first - lambdas[i].first) + abs(cell.second - lambdas[i].second));
+	return distance;
+}
+
+// Description: Returns the next number of the xorshift generator of the worker
+unsigned MctsSolver::NextRandom(unsigned long long & random)
+{
+	random ^= random >> 12;
+	random ^= random << 25;
+	random ^= random >> 27;
+	return (unsigned) ((random * 0x2545F4914F6CDD1DULL) >> 32);
+}
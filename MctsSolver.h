@@ -0,0 +1,77 @@
+#pragma once
+
+#include "stdafx.h"
+#include "Field.h"
+#include "FieldArena.h"
+#include <pthread.h>
+
+// Monte Carlo tree search solver.
+// The game is played one command at a time. Before every command each thread grows its own tree
+// from the current state: it selects children by UCT, adds one child and plays a rollout of cheap
+// random or greedy commands from it. A rollout is worth the best score which escaping or aborting
+// at one of its moves gives. The command visited most in all trees is played. The best game met
+// by any rollout is remembered, and its commands are the trace.
+class MctsSolver
+{
+	// Node of a tree, children are indexed by the commands
+	struct Node
+	{
+		int parent;
+		_Command command;
+		int children[5];	// -1 if the command wasn't tried, -2 if the robot can't make it
+		int tried;			// commands tried
+		int visits;
+		double total;		// sum of the values of the rollouts
+		Field * field;
+		int score;			// score of the game before the bonus for escaping or aborting
+		int lambdas;		// lambdas collected
+		bool terminal;		// the robot died or escaped
+	};
+
+	// Tree grown by one thread, the best game it has met and its random generator
+	struct Worker
+	{
+		MctsSolver * solver;
+		vector<Node> nodes;
+		unsigned long long random;
+		size_t rollouts;
+		int bestScore;
+		vector<_Command> bestCommands;	// commands after the current state, ABORT included
+	};
+
+	Field mine;
+	int score;				// game played so far
+	int lambdas;
+	vector<_Command> trace;
+	int iterations;			// rollouts of every thread before a command
+	int threadsNum;
+	size_t rollouts;
+	vector<int> distances;	// walking distances through the walls to the targets of the current state
+	size_t measuredLambdas;	// lambdas left when the distances were measured
+
+public:
+	MctsSolver(Field & amine);
+	~MctsSolver(void);
+
+	void SetIterations(int aiterations);
+	void SetThreads(int threads);	// 0 uses all processors
+	void Solve();
+
+	const vector<_Command> & GetTrace();	// commands of the best game, ABORT is added if the lift isn't reached
+	size_t GetRollouts();
+
+private:
+	static void * Search(void * worker);
+	void GrowTree(Worker & worker);
+	int Select(Worker & worker, int node);
+	int AddChild(Worker & worker, int node, int command);
+	int Rollout(Worker & worker, int node);
+	void Remember(Worker & worker, int node, const vector<_Command> & commands, int value);
+	void ReleaseTree(Worker & worker);
+
+	void MeasureDistances();
+	int Distance(Field & field, IntPair cell);	// distance to the nearest lambda or to the lift
+
+	static int AbortScore(int score, int lambdas);
+	static unsigned NextRandom(unsigned long long & random);
+};
@@ -0,0 +1,149 @@
+#include "OpenList.h"
+
+
+OpenList::OpenList(void)
+{
+	width = 0;
+	length = 0;
+}
+
+void OpenList::Resize(size_t aheight, size_t awidth)
+{
+	width = awidth;
+	length = 0;
+	heap.assign(width * aheight + 2, OpenListItem());
+	slots.assign(width * aheight, 0);
+}
+
+void OpenList::Clear()
+{
+	for (int i = 1; i <= length; i++)
+		slots[heap[i].GetX() * width + heap[i].GetY()] = 0;
+	length = 0;
+}
+
+// Description: Adds the item and moves it to the proper position in the heap
+void OpenList::Push(const OpenListItem & item)
+{
+	length++;
+	Place(length, item);
+	Bubble(length);
+}
+
+// Description: Deletes the top item and reorders the heap, with the lowest F cost item rising to the top
+void OpenList::Pop()
+{
+	slots[heap[1].GetX() * width + heap[1].GetY()] = 0;
+	length--;
+	if (length == 0) return;
+	Place(1, heap[length + 1]);		// move last item up to slot #1
+	Sink(1);
+}
+
+int OpenList::Find(int x, int y)
+{
+	int index = slots[x * width + y];
+	return index ? index : -1;
+}
+
+void OpenList::DecreaseGcost(int index, int Gcost)
+{
+	heap[index].SetGcost(Gcost);
+	heap[index].CalculateFcost();
+	Bubble(index);
+}
+
+void OpenList::Place(int index, const OpenListItem & item)
+{
+	heap[index] = item;
+	slots[heap[index].GetX() * width + heap[index].GetY()] = index;
+}
+
+// Description: Bubbles the item up while its F cost isn't greater than the parent's one
+void OpenList::Bubble(int index)
+{
+	while (index != 1) {	// While item hasn't bubbled to the top
+		// Swap items if child < parent.
+		if (heap[index].GetFcost() <= heap[index/2].GetFcost()) {
+			OpenListItem temp = heap[index/2];
+			Place(index/2, heap[index]);
+			Place(index, temp);
+			index = index/2;
+		} else break;
+	}
+}
+
+// Description: Sinks the item down to its proper position
+void OpenList::Sink(int index)
+{
+	int curr, next = index;
+
+	// Repeat the following until the item sinks to its proper spot in the heap.
+	while (true) {
+		curr = next;
+		if (2*curr + 1 <= length) {	// if both children exist
+			// Check if the F cost of the parent is greater than each child and select the lowest one.
+			if (heap[curr].GetFcost() >= heap[2*curr].GetFcost())
+				next = 2*curr;
+			if (heap[next].GetFcost() >= heap[2*curr + 1].GetFcost())
+				next = 2*curr+1;
+		} else {
+			if (2*curr <= length) {	// if only child #1 exists
+				// Check if the F cost of the parent is greater than child #1
+				if (heap[curr].GetFcost() >= heap[2*curr].GetFcost())
+					next = 2*curr;
+			}
+		}
+
+		if (curr != next) {	// if parent's F > one of its children, swap them
+			OpenListItem temp = heap[curr];
+			Place(curr, heap[next]);
+			Place(next, temp);
+		} else break;		// otherwise, exit loop
+	}
+}
+
+
+ClosedList::ClosedList(void)
+{
+	width = 0;
+	length = 0;
+}
+
+void ClosedList::Resize(size_t aheight, size_t awidth)
+{
+	width = awidth;
+	length = 0;
+	items.assign(width * aheight + 1, OpenListItem());
+	slots.assign(width * aheight, 0);
+}
+
+void ClosedList::Clear()
+{
+	for (int i = 1; i <= length; i++)
+		slots[items[i].GetX() * width + items[i].GetY()] = 0;
+	length = 0;
+}
+
+void ClosedList::Push(const OpenListItem & item)
+{
+	length++;
+	items[length] = item;
+	slots[items[length].GetX() * width + items[length].GetY()] = length;
+}
+
+int ClosedList::Find(int x, int y)
+{
+	int index = slots[x * width + y];
+	return index ? index : -1;
+}
+
+void ClosedList::Remove(int index)
+{
+	slots[items[index].GetX() * width + items[index].GetY()] = 0;
+	if (index != length) {
+		items[index] = items[length];
+		slots[items[index].GetX() * width + items[index].GetY()] = index;
+	}
+	length--;
+}
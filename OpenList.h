@@ -0,0 +1,59 @@
+#pragma once
+
+#include "stdafx.h"
+#include "OpenListItem.h"
+
+// Open list of an A* search: binary heap of the items ordered by F cost, from slot #1.
+// The heap slot of every listed cell is kept, so an item is found by its cell without a scan
+// and its cost is decreased in O(log n). Cells which are not listed have slot 0.
+class OpenList
+{
+	size_t width;
+	vector<OpenListItem> heap;
+	vector<int> slots;			// heap slot of every cell
+	int length;
+
+public:
+	OpenList(void);
+
+	void Resize(size_t aheight, size_t awidth);	// empties the list and resizes it to the map
+	void Clear();								// empties the list, only listed cells are touched
+
+	int Size() { return length; }
+	bool Empty() { return length == 0; }
+	OpenListItem & Top() { return heap[1]; }
+	OpenListItem & operator [] (int index) { return heap[index]; }
+
+	void Push(const OpenListItem & item);
+	void Pop();									// deletes the top item
+	int Find(int x, int y);						// returns heap slot of the cell or -1
+	void DecreaseGcost(int index, int Gcost);	// sets the lower G cost of the item and lifts it
+
+private:
+	void Place(int index, const OpenListItem & item);
+	void Bubble(int index);
+	void Sink(int index);
+};
+
+// Closed list of an A* search: unordered items from slot #1 with the slot of every listed cell,
+// so an item is found and removed in constant time. Slot 0 holds an empty item.
+class ClosedList
+{
+	size_t width;
+	vector<OpenListItem> items;
+	vector<int> slots;			// slot of every cell, 0 if the cell isn't listed
+	int length;
+
+public:
+	ClosedList(void);
+
+	void Resize(size_t aheight, size_t awidth);	// empties the list and resizes it to the map
+	void Clear();								// empties the list, only listed cells are touched
+
+	int Size() { return length; }
+	OpenListItem & operator [] (int index) { return items[index]; }
+
+	void Push(const OpenListItem & item);
+	int Find(int x, int y);						// returns slot of the cell or -1
+	void Remove(int index);						// moves the last item to the slot
+};
@@ -0,0 +1,159 @@
+#include "SearchWorkspace.h"
+
+
+SearchMarks::SearchMarks(void)
+{
+	width = 0;
+	height = 0;
+	generation = 1;
+}
+
+void SearchMarks::Resize(size_t aheight, size_t awidth)
+{
+	width = awidth;
+	height = aheight;
+	generation = 1;
+	stamps.assign(width * height, 0);
+}
+
+void SearchMarks::Clear()
+{
+	generation++;
+
+	// Stamps of the oldest generations would be read as new ones, so they are really cleared
+	if (generation > (~0u >> 2)) {
+		generation = 1;
+		stamps.assign(stamps.size(), 0);
+	}
+}
+
+
+SearchWorkspace::SearchWorkspace(void)
+{
+	width = 0;
+	height = 0;
+	snapshotBudget = SEARCH_SNAPSHOT_BUDGET;
+	heldBytes = 0;
+}
+
+SearchWorkspace::SearchWorkspace(const SearchWorkspace & workspace)
+{
+	width = 0;
+	height = 0;
+	snapshotBudget = workspace.snapshotBudget;
+	heldBytes = 0;
+}
+
+SearchWorkspace::~SearchWorkspace(void)
+{
+	ReleaseSnapshots();
+	for (size_t i = 0; i < spareFields.size(); i++)
+		delete spareFields[i];
+}
+
+void SearchWorkspace::Prepare(size_t aheight, size_t awidth, bool withSnapshots)
+{
+	ReleaseSnapshots();
+
+	if (aheight != height || awidth != width || parents.empty()) {
+		width = awidth;
+		height = aheight;
+
+		marks.Resize(height, width);
+		parentCells.assign(width * height + 1, IntPair());
+		parents.resize(height + 1);
+		for (size_t i = 0; i < height; i++)
+			parents[i] = &parentCells[i * width];
+		openList.Resize(height, width);
+		closedList.Resize(height, width);
+		cellNodes.clear();
+	} else {
+		marks.Clear();
+		openList.Clear();
+		closedList.Clear();
+	}
+
+	if (withSnapshots && cellNodes.empty())
+		cellNodes.assign(width * height, -1);
+}
+
+// Description: Sets the estimated memory which snapshots of the search may hold besides the roots
+void SearchWorkspace::SetSnapshotBudget(size_t bytes)
+{
+	snapshotBudget = bytes;
+	EvictSnapshots();
+}
+
+// Description: Saves the field reached at the cell by a step from the source node
+// Returns: node of the snapshot; a source of -1 makes a root, which has to be saved as it is
+int SearchWorkspace::SaveSnapshot(int x, int y, int source, const Field & field)
+{
+	SnapshotNode node;
+	node.source = source;
+	node.cell = IntPair(x, y);
+	node.field = NULL;
+	node.bytes = 0;
+	nodes.push_back(node);
+
+	int index = nodes.size() - 1;
+	cellNodes[x * width + y] = index;
+	HoldSnapshot(index, field);
+	return index;
+}
+
+void SearchWorkspace::RestoreSnapshot(int node, const Field & field)
+{
+	if (!nodes[node].field) HoldSnapshot(node, field);
+}
+
+// Description: Frees the snapshots, so the tiles they share with others aren't held between the searches
+void SearchWorkspace::ReleaseSnapshots()
+{
+	for (size_t i = 0; i < nodes.size(); i++) {
+		if (nodes[i].field) {
+			*nodes[i].field = Field();
+			spareFields.push_back(nodes[i].field);
+		}
+	}
+	nodes.clear();
+	heldNodes.clear();
+	heldBytes = 0;
+}
+
+SearchWorkspace & SearchWorkspace::operator = (const SearchWorkspace & workspace)
+{
+	snapshotBudget = workspace.snapshotBudget;
+	return *this;
+}
+
+void SearchWorkspace::HoldSnapshot(int node, const Field & field)
+{
+	SnapshotNode & snapshot = nodes[node];
+	if (spareFields.empty()) {
+		snapshot.field = new Field(field);
+	} else {
+		snapshot.field = spareFields.back();
+		spareFields.pop_back();
+		*snapshot.field = field;
+	}
+	if (snapshot.source == -1) return;
+
+	// Tiles shared with the source are counted once, by the source
+	Field * source = nodes[snapshot.source].field;
+	snapshot.bytes = snapshot.field->GetBytesApartFrom(source);
+	heldBytes += snapshot.bytes;
+	heldNodes.push_back(node);
+	EvictSnapshots();
+}
+
+void SearchWorkspace::EvictSnapshots()
+{
+	while (heldBytes > snapshotBudget && !heldNodes.empty()) {
+		SnapshotNode & snapshot = nodes[heldNodes.front()];
+		heldNodes.pop_front();
+		heldBytes -= snapshot.bytes;
+		*snapshot.field = Field();
+		spareFields.push_back(snapshot.field);
+		snapshot.field = NULL;
+	}
+}
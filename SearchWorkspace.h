@@ -0,0 +1,113 @@
+#pragma once
+
+#include "stdafx.h"
+#include "Field.h"
+#include "OpenList.h"
+#include <deque>
+
+// Marks of the cells telling whether the cell is on the open list or on the closed list.
+// Every mark is stamped with the generation it was set in and marks of older generations read as 0,
+// so all marks are cleared at once by starting a new generation.
+class SearchMarks
+{
+	size_t width;
+	size_t height;
+	unsigned generation;
+	vector<unsigned> stamps;	// generation << 2 | mark of every cell
+
+public:
+	// Mark of one cell, used like int
+	class Mark
+	{
+		unsigned * stamp;
+		unsigned generation;
+	public:
+		Mark(unsigned * astamp, unsigned ageneration) : stamp(astamp), generation(ageneration) {}
+
+		operator int() const { return (*stamp >> 2) == generation ? (int) (*stamp & 3) : 0; }
+		Mark & operator = (int mark) { *stamp = generation << 2 | mark; return *this; }
+	};
+
+	class Row
+	{
+		unsigned * stamps;
+		unsigned generation;
+	public:
+		Row(unsigned * astamps, unsigned ageneration) : stamps(astamps), generation(ageneration) {}
+
+		Mark operator [] (int y) const { return Mark(stamps + y, generation); }
+	};
+
+	SearchMarks(void);
+
+	void Resize(size_t aheight, size_t awidth);	// clears the marks and resizes them to the map
+	void Clear();								// starts a new generation
+
+	Row operator [] (int x) { return Row(&stamps[x * width], generation); }
+};
+
+// Memory of the A* searches on one map, kept between the searches.
+// It is allocated when the first search on the map is prepared; the next searches only start
+// a new generation of the marks, so preparing them doesn't depend on the size of the map.
+// Parents are always written by the search before it reads them, the lists are emptied
+// by clearing only the cells left on them.
+// Copies of the workspace are empty, it holds nothing but scratch memory.
+//
+// Searches which need field states save a snapshot for every expanded node. A node remembers
+// the node it was stepped from and the cell of the step, so an evicted snapshot can be made
+// again by replaying the steps from the nearest held one. Snapshots which are not roots are
+// evicted oldest first when their estimated size exceeds the budget; roots are never evicted.
+class SearchWorkspace
+{
+	struct SnapshotNode
+	{
+		int source;			// node the step was made from, -1 for roots
+		IntPair cell;		// cell the robot stepped to
+		Field * field;		// saved state or NULL if it was evicted
+		size_t bytes;		// estimated memory held by the state alone
+	};
+
+	size_t width;
+	size_t height;
+
+	SearchMarks marks;
+	vector<IntPair> parentCells;
+	vector<IntPair *> parents;			// rows of parentCells
+	OpenList openList;
+	ClosedList closedList;
+
+	vector<SnapshotNode> nodes;			// snapshot nodes of the current search
+	vector<int> cellNodes;				// latest node of every cell saved by the current search
+	deque<int> heldNodes;				// nodes which are not roots and hold a state, oldest first
+	vector<Field *> spareFields;		// empty Fields of evicted snapshots
+	size_t snapshotBudget;
+	size_t heldBytes;
+
+public:
+	SearchWorkspace(void);
+	SearchWorkspace(const SearchWorkspace & workspace);
+	~SearchWorkspace(void);
+
+	void Prepare(size_t aheight, size_t awidth, bool withSnapshots = false);	// starts a new search on the map
+
+	SearchMarks & GetMarks() { return marks; }
+	IntPair ** GetParents() { return &parents[0]; }
+	OpenList & GetOpenList() { return openList; }
+	ClosedList & GetClosedList() { return closedList; }
+
+	void SetSnapshotBudget(size_t bytes);
+	int SaveSnapshot(int x, int y, int source, const Field & field);	// returns node of the state reached at the cell
+	void RestoreSnapshot(int node, const Field & field);	// keeps the replayed state of the evicted node
+	void ReleaseSnapshots();			// frees the snapshots saved by the search
+
+	int GetSnapshotNode(int x, int y) { return cellNodes[x * width + y]; }
+	Field * GetSnapshot(int node) { return nodes[node].field; }
+	int GetSnapshotSource(int node) { return nodes[node].source; }
+	IntPair GetSnapshotCell(int node) { return nodes[node].cell; }
+
+	SearchWorkspace & operator = (const SearchWorkspace & workspace);
+
+private:
+	void HoldSnapshot(int node, const Field & field);
+	void EvictSnapshots();
+};
@@ -1,10 +1,15 @@
 #include "Simulator.h"
+#include "Deadline.h"
+#include "DangerMap.h"
 
 
 Simulator::Simulator(Field & amine)
 {
 	this->mine = amine;
 	robotIsDead = false;
+	snapshot = 0;
+	expanded = 0;
+	walkDistance = SAFE_WALK_MIN_DISTANCE;
 }
 
 
@@ -12,13 +17,30 @@ Simulator::~Simulator(void)
 {
 }
 
-vector<IntPair> Simulator::GetPath()
+const vector<IntPair> & Simulator::GetPath()
 {
 	return this->path;
 }
 
-void Simulator::StartSimulation(vector<IntPair> waypoints)
+void Simulator::SetSnapshotBudget(size_t bytes)
 {
+	workspace.SetSnapshotBudget(bytes);
+}
+
+void Simulator::SetSafeWalk(int distance)
+{
+	walkDistance = distance;
+}
+
+size_t Simulator::GetExpandedNodes()
+{
+	return this->expanded;
+}
+
+void Simulator::StartSimulation(const vector<IntPair> & waypoints)
+{
+	FieldArena arena;	// tiles released during the simulation are reused and freed when it ends
+
 	//cout << "Lambdas: " << waypoints.size() - 2 << endl;
 
 	mine.ClearLambdas();
@@ -27,9 +49,13 @@ void Simulator::StartSimulation(vector<IntPair> waypoints)
 	}
 
 	int result;
-	missedLambdas.clear();
+	missedLambdas.Reset(mine.GetHeight(), mine.GetWidth());
+	unexpectedLambdas.assign(waypoints.size(), false);
+
+	for (int i = mine.GetLambdasNum() - 1; i >= 0; i--) {					// waypoint #0 is a Robot !!!
+		// The way made so far is kept when the budget ends
+		if (Deadline::Expired()) break;
 
-	for (int i = mine.GetLambdas().size() - 1; i >= 0; i--) {					// waypoint #0 is a Robot !!!
 		if (FindUnexpectedLambda(i)) {
 			mine.PopBackLambda();
 			continue;
@@ -41,17 +67,15 @@ void Simulator::StartSimulation(vector<IntPair> waypoints)
 		//snapshot.back().SaveMap(cout);
 		//size_t index = path.size();
 
-		result = MoveRobotToTarget(mine.GetLambdas().at(i));
+		result = MoveRobotToTarget(mine.GetLambda(i));
 
 		if (result == 0) {
-			if (snapshot.empty()) break;
-			
 			LoadSnapshot();
 
 			//cout << "Loaded global snapshot:" << endl;
 			//mine.SaveMap(cout);
 
-			missedLambdas.push_back(mine.GetLambdas().at(i));
+			missedLambdas.Add(mine.GetLambda(i));
 			continue;
 		}
 
@@ -59,6 +83,8 @@ void Simulator::StartSimulation(vector<IntPair> waypoints)
 		
 	}
 
+	mine.StopJournal();
+
 	//int n = mine.GetLambdas().size();
 	//bool finished = true;
 	//if (n > 0) {
@@ -80,7 +106,7 @@ void Simulator::UpdateMap()
 
 	// If (x; y) contains a Closed Lambda Lift, and there are no Lambdas remaining:
 	// (x; y) is updated to Open Lambda Lift.
-	if (mine.GetLambdas().size() == 1 && mine.GetLambdas().back() == mine.GetLift() && missedLambdas.empty()) {
+	if (mine.GetLambdasNum() == 1 && mine.GetLambda(0) == mine.GetLift() && missedLambdas.Empty()) {
 		mine.SetLiftState(true);
 		mine.SetObject(mine.GetLift().first, mine.GetLift().second, OPENED_LIFT);
 	}
@@ -120,13 +146,48 @@ bool Simulator::IsLiftBlocked() {			// is lift blocked? lets see (will return tr
 	return false;
 }
 
+// Description: Moves the robot to the target. The safe runs of the shortest way are walked without
+// the search, the search goes only through the pieces of the way near rocks. The way is found again after
+// every piece, as rocks have moved. If a piece can't be passed, everything is undone and the search goes
+// from the start to the target as a whole.
+// Returns: 1 if the robot is at the target, 0 otherwise
+int Simulator::MoveRobotToTarget(IntPair target)
+{
+	const int found = 1;
+	size_t startMark = mine.MarkJournal();
+	size_t pathSize = path.size();
+	vector<bool> collected = unexpectedLambdas;
+
+	int result = -1;
+	int left = -1;		// length of the way left before the last walk, -1 before the first one
+	IntPair end;
+	while (result == -1) {
+		int length = WalkSafeRun(target, end);
+		if (length == -1 || (left != -1 && length >= left)) break;	// the rest of the way is searched as a whole
+		left = length;
+		if (mine.GetRobot() == target) result = found;
+		else if (SearchWay(end) != found) result = 0;
+		else if (end == target) result = found;
+	}
+	if (result == -1) result = SearchWay(target);
+
+	if (result != found && left != -1) {
+		mine.RollbackJournal(startMark);
+		path.resize(pathSize);
+		unexpectedLambdas = collected;
+		result = SearchWay(target);
+	}
+	mine.ReleaseJournalMark(startMark);
+	return result;
+}
+
 // Using A star algorithm modified for taking care about dynamic changes on map
 // At the begining - add reaction on the robot death
-int Simulator::MoveRobotToTarget(IntPair target) {
+int Simulator::SearchWay(IntPair target) {
+
+	FieldArena arena;	// snapshots of the cells share tiles of one pool
 
 	const int infinity = 1000000;	// infinity Hcost of the cell where robot dies
-	int numberOfClosedListItems = 0;
-	OpenListItem * closedList;	// array holding closed list items
 
 	int startX = mine.GetRobot().first;
 	int startY = mine.GetRobot().second;
@@ -137,58 +198,24 @@ int Simulator::MoveRobotToTarget(IntPair target) {
 	const int nonexistent = 0, found = 1;		// path-related constants
 	const int inClosedList = 2;	// lists-related constants
 	int parentX, parentY, Gcost;
-	int ** whichList;			// used to record whether a cell is on the open list or on the closed list.
-	IntPair ** parent;	// used to record parent of each cage
-	OpenListItem * openList;	// array holding open list items, which is maintained as a binary heap.
-	int numberOfOpenListItems = 0;
-
-// ****************************
 
-	Field ** cellsnapshot;	// array holding current field state for each cell (when robot stays on it)
-
-// ****************************
-
-// 1. Allocate memory and reset variables
-
-	whichList = new int* [mine.GetHeight() + 1];
-	for (int i = 0; i < mine.GetHeight(); i++) {
-		whichList[i] = new int [mine.GetWidth() + 1];
-		for (int j = 0; j < mine.GetWidth(); j++)
-			whichList[i][j] = 0;
-	}
-
-	parent = new IntPair * [mine.GetHeight() + 1];
-	for (int i = 0; i < mine.GetHeight(); i++) {
-		parent[i] = new IntPair [mine.GetWidth() + 1];
-	}
-
-	openList = new OpenListItem [mine.GetWidth()*mine.GetHeight()+2];
-
-
-// ****************************
-
-	closedList = new OpenListItem [mine.GetWidth()*mine.GetHeight()+2];
-	
-	cellsnapshot = new Field* [mine.GetHeight() + 1];
-	for (int i = 0; i < mine.GetHeight(); i++) {
-		cellsnapshot[i] = new Field [mine.GetWidth() + 1];
-	}
-	
-// ****************************
+// 1. Start a new search in the workspace
 
+	workspace.Prepare(mine.GetHeight(), mine.GetWidth(), true);
+	SearchMarks & whichList = workspace.GetMarks();	// used to record whether a cell is on the open list or on the closed list.
+	IntPair ** parent = workspace.GetParents();		// used to record parent of each cage
+	OpenList & openList = workspace.GetOpenList();		// open list items, which are maintained as a binary heap.
+	ClosedList & closedList = workspace.GetClosedList();
 
 // 2. Add the starting cell to the open list.
 	
-	numberOfOpenListItems = 1;
-	openList[1].SetX(startX);	// assign it as the top item in the binary heap
-	openList[1].SetY(startY);
-	openList[1].SetGcost(0);	// reset starting cell's G value to 0
+	openList.Push(OpenListItem(startX, startY, 0, 0));	// starting cell's G value is 0
 	parent[startX][startY] = IntPair (startX, startY);
 	
 
 // ****************************
 
-	cellsnapshot[startX][startY] = mine;	// first snapshot at start point
+	workspace.SaveSnapshot(startX, startY, -1, mine);	// first snapshot at start point
 	
 // ****************************
 
@@ -197,8 +224,7 @@ int Simulator::MoveRobotToTarget(IntPair target) {
 
 
 	/*
-	result = Step(IntPair(startX, startY), 0, openList, numberOfOpenListItems, whichList, parent, 
-			target, closedList, numberOfClosedListItems);
+	result = Step(IntPair(startX, startY), 0, openList, whichList, parent, target, closedList);
 
 	if (result == found) {
 		// Working backwards from the target to the start by checking each cell's parent.
@@ -236,7 +262,7 @@ int Simulator::MoveRobotToTarget(IntPair target) {
 
 // 3.0 Analyze target cell's position
 
-	// Trying to avoid situations like this:
+	// There is no point in searching in situations like this:
 	//
 	//  *
 	// #\#
@@ -251,34 +277,50 @@ int Simulator::MoveRobotToTarget(IntPair target) {
 	// ###
 	// 
 
-	// IsDeadLock(target.first, target.second);
+	// MapAnalysis finds lambdas which such rocks really lock when the map is loaded, they never become targets.
 
 	while (true) {
 	
 // 3.1. If the open list is not empty, take the first cell off of the list (i.e. the lowest F cost cell).
 
-		if (numberOfOpenListItems != 0) {
+		if (!openList.Empty() && !Deadline::Expired()) {
 
 			// record cell coordinates and Gcost of the item as parent for adjacent cells (see below)
-			parentX = openList[1].GetX();
-			parentY = openList[1].GetY();
-			Gcost = openList[1].GetGcost();
+			parentX = openList.Top().GetX();
+			parentY = openList.Top().GetY();
+			Gcost = openList.Top().GetGcost();
+			expanded++;
 
 
 // ***************************
 
+			size_t stepMark = 0;	// journal mark of the parent's state, a failed step is rolled back to it
+			bool stepMade = false;
+			int sourceNode = -1;	// snapshot node of the parent's state
+
 			// If it is not the start cell
-			if (openList[1].GetX() != startX || openList[1].GetY() != startY) {
+			if (parentX != startX || parentY != startY) {
 				// loading field state relating to this cell's parent (from which robot makes a step to this cell)
-				mine = cellsnapshot[ parent[parentX][parentY].first ] [ parent[parentX][parentY].second ];
+				sourceNode = LoadCellSnapshot(parent[parentX][parentY].first, parent[parentX][parentY].second);
+
+				// A step killing the robot is found by the danger map and isn't made at all
+				IntPair robot = mine.GetRobot();
+				_Command command = parentX < robot.first ? UP : parentX > robot.first ? DOWN : parentY < robot.second ? LEFT : RIGHT;
+				robotIsDead = DangerMap::IsLethalMove(mine, command);
+			}
+
+			if ((parentX != startX || parentY != startY) && !robotIsDead) {
+				stepMark = mine.MarkJournal();
+				stepMade = true;
 				// making a step and updating map
-				bool stoneMoved = MoveRobot(openList[1].GetX(), openList[1].GetY());
+				bool stoneMoved = MoveRobot(parentX, parentY);
 
 				if (stoneMoved && IsLiftBlocked()) {
-					openList[1].SetHcost(infinity);
-					whichList[parentX][parentY] = inClosedList;                   // add item to the closed list
-					DeleteTopItemFromBinaryHeap(openList, numberOfOpenListItems); // delete this item from the open list
-					mine = cellsnapshot[ parent[parentX][parentY].first ] [ parent[parentX][parentY].second ];
+					openList.Top().SetHcost(infinity);
+					whichList[parentX][parentY] = inClosedList;		// add item to the closed list
+					openList.Pop();									// delete this item from the open list
+					mine.RollbackJournal(stepMark);									// undo the step
+					mine.ReleaseJournalMark(stepMark);
 					continue;
 			    }
 
@@ -299,13 +341,15 @@ int Simulator::MoveRobotToTarget(IntPair target) {
 				//}
 
 				// If it is not our target cell, set infinity H cost and transfer item to the closed list - it is not the best rule
-				openList[1].SetHcost(infinity);
-				whichList[parentX][parentY] = inClosedList;						// add item to the closed list
-				numberOfClosedListItems++;
-				closedList[numberOfClosedListItems] = openList[1];
-				DeleteTopItemFromBinaryHeap(openList, numberOfOpenListItems);	// delete this item from the open list
+				openList.Top().SetHcost(infinity);
+				whichList[parentX][parentY] = inClosedList;		// add item to the closed list
+				closedList.Push(openList.Top());
+				openList.Pop();									// delete this item from the open list
 
-				mine = cellsnapshot[ parent[parentX][parentY].first ] [ parent[parentX][parentY].second ];	// load snapshot
+				if (stepMade) {
+					mine.RollbackJournal(stepMark);		// undo the step
+					mine.ReleaseJournalMark(stepMark);
+				}
 
 				//cout << "Back:" << endl;
                 //mine.SaveMap(cout);																		// testing print to stdout
@@ -314,32 +358,33 @@ int Simulator::MoveRobotToTarget(IntPair target) {
 				continue;
 			}
 
-			if (openList[1].GetX() == target.first && openList[1].GetY() == target.second) {
+			if (stepMade) mine.ReleaseJournalMark(stepMark);
+
+			if (parentX == target.first && parentY == target.second) {
 				result = found;
 				break;
 			}
 
-			cellsnapshot[parentX][parentY] = mine;
+			// States saved without a step can't be replayed, they become roots
+			workspace.SaveSnapshot(parentX, parentY, sourceNode, mine);
 
 // ***************************
 
-			whichList[parentX][parentY] = inClosedList;						// add item to the closed list
-			numberOfClosedListItems++;
-			closedList[numberOfClosedListItems] = openList[1];
-			DeleteTopItemFromBinaryHeap(openList, numberOfOpenListItems);	// delete this item from the open list
+			whichList[parentX][parentY] = inClosedList;		// add item to the closed list
+			closedList.Push(openList.Top());
+			openList.Pop();									// delete this item from the open list
 
 // 3.2. Check the adjacent squares and add them to the open list
 
-			AddAdjacentCellsToOpenList(openList, numberOfOpenListItems, parentX, parentY, Gcost,
-									   whichList, parent, target, closedList, numberOfClosedListItems);
+			AddAdjacentCellsToOpenList(openList, parentX, parentY, Gcost, whichList, parent, target, closedList);
 
-			//cout << numberOfOpenListItems << endl;
-			//for (int k = 1; k < numberOfOpenListItems + 1; k++)
+			//cout << openList.Size() << endl;
+			//for (int k = 1; k < openList.Size() + 1; k++)
 			//	cout << openList[k].GetX() << ":" << openList[k].GetY() << " F: " << openList[k].GetFcost() << " G: " << openList[k].GetGcost() << endl;
 
 		} else {
 
-// 3.3. If open list is empty then there is no path.	
+// 3.3. If open list is empty or the budget is over then there is no path.	
 		
 			result = nonexistent;
 			break;
@@ -374,28 +419,85 @@ int Simulator::MoveRobotToTarget(IntPair target) {
 
 			int index = mine.FindLambda(path.back());
 			if (index == -1) index = FindMissedLambda(path.back());
-			if (index != -1) unexpectedLambdas.push_back(index);
+			if (index != -1) unexpectedLambdas[index] = true;
 		}
 		
 	} //else return -1;
 
-// 7. Freeing used memory
+// 7. Freeing snapshots while the arena can take their tiles
+
+	workspace.ReleaseSnapshots();
 
-	for (int i = 0; i < mine.GetHeight(); i++) {
-		delete [] whichList[i];
-		delete [] parent[i];
-		delete [] cellsnapshot[i];
+	return result;
+}
+
+// Description: Finds the shortest way to the target at least walkDistance away over the field
+// as it is now and walks it while the robot leaves safe cells. No rock moves while the robot does it,
+// if the field is stable, so the search with its snapshots isn't needed. The end is set to the first
+// cell after the walk from which the robot can leave safely again, or to the target.
+// Returns: length of the way before the walk or -1 if the robot can't walk, it doesn't move then
+int Simulator::WalkSafeRun(IntPair target, IntPair & end)
+{
+	IntPair robot = mine.GetRobot();
+	int manhattan = abs(robot.first - target.first) + abs(robot.second - target.second);
+	if (walkDistance == 0 || manhattan < walkDistance) return -1;
+
+	// The search finds that the robot can't enter the closed lift
+	if (!mine.isWalkable(target.first, target.second) || !mine.IsStable()) return -1;
+
+	size_t jumpPoints = jumps.GetExpandedNodes();
+	jumps.Prepare(mine);
+	int length = jumps.FindPath(robot, target, false, &safeWay);
+	expanded += jumps.GetExpandedNodes() - jumpPoints;
+	if (length <= 0) return -1;
+
+	size_t walked = 0;
+	while (walked < safeWay.size() && jumps.IsSafe(mine.GetRobot())) {
+		MoveRobot(safeWay[walked].first, safeWay[walked].second);
+		UpdateMap();
+		path.push_back(safeWay[walked]);
+		walked++;
 	}
-	delete [] openList;
 
-	delete [] closedList;
+	size_t k = walked;
+	while (k + 1 < safeWay.size() && !jumps.IsSafe(safeWay[k])) k++;
+	end = walked < safeWay.size() ? safeWay[k] : target;
 
-	return result;
+	for (size_t i = 0; i < walked; i++) {
+		int index = mine.FindLambda(safeWay[i]);
+		if (index == -1) index = FindMissedLambda(safeWay[i]);
+		if (index != -1) unexpectedLambdas[index] = true;
+	}
+	return length;
+}
+
+// Description: Loads the state saved for the cell, replaying the steps to it if the snapshot was evicted
+// Returns: snapshot node of the state
+int Simulator::LoadCellSnapshot(int x, int y)
+{
+	int node = workspace.GetSnapshotNode(x, y);
+
+	vector<IntPair> steps;		// cells of the replayed steps in reverse order
+	int held = node;
+	while (!workspace.GetSnapshot(held)) {
+		steps.push_back(workspace.GetSnapshotCell(held));
+		held = workspace.GetSnapshotSource(held);
+	}
+
+	mine = *workspace.GetSnapshot(held);
+	if (steps.empty()) return node;
+
+	for (int i = steps.size() - 1; i >= 0; i--) {
+		MoveRobot(steps[i].first, steps[i].second);
+		UpdateMap();
+	}
+	workspace.RestoreSnapshot(node, mine);
+	return node;
 }
 
 // Magic.
-int Simulator::Step(IntPair cell, int Gcost, OpenListItem * openList, int & numberOfOpenListItems, int ** whichList, 
-	IntPair ** parent, IntPair target, OpenListItem * closedList, int & numberOfClosedListItems)
+int Simulator::Step(IntPair cell, int Gcost, OpenList & openList, SearchMarks & whichList, 
+	IntPair ** parent, IntPair target, ClosedList & closedList)
 {
 	const int nonexistent = 0, found = 1;
 	int result = nonexistent;
@@ -409,47 +511,40 @@ int Simulator::Step(IntPair cell, int Gcost, OpenListItem * openList, int & numb
 	parentX = cell.first;
 	parentY = cell.second;
 
-	OpenListItem * currOpenList = new OpenListItem [mine.GetWidth()*mine.GetHeight()+2];
-	int currNumberOfOpenedItems;
-	OpenListItem * currClosedList = new OpenListItem [mine.GetWidth()*mine.GetHeight()+2];
-	int currNumberOfClosedItems;
+	OpenList currOpenList;
+	ClosedList currClosedList;
 
 	Field snapshot = mine;
 	do {
 		// Check the adjacent squares and add them to the open list
-		AddAdjacentCellsToOpenList(openList, numberOfOpenListItems, parentX, parentY, Gcost,
-									whichList, parent, target, closedList, numberOfClosedListItems);
+		AddAdjacentCellsToOpenList(openList, parentX, parentY, Gcost, whichList, parent, target, closedList);
 
 		// making a step and updating map
-		bool stoneMoved = MoveRobot(openList[1].GetX(), openList[1].GetY());
+		bool stoneMoved = MoveRobot(openList.Top().GetX(), openList.Top().GetY());
 		UpdateMap();
 
 		// Step was made - we can check new position
 		// Cheking robot's death after update and lift blocking situations
 		if (robotIsDead || (stoneMoved && IsLiftBlocked())) {
-			DeleteTopItemFromBinaryHeap(openList, numberOfOpenListItems);	// delete this item from the open list
+			openList.Pop();		// delete this item from the open list
 			mine = snapshot;	// load snapshot
 			robotIsDead = false;
 			continue;
 		}
 
-		if (openList[1].GetX() == target.first && openList[1].GetY() == target.second) {
+		if (openList.Top().GetX() == target.first && openList.Top().GetY() == target.second) {
 			result = found;
 			break;
 		}
 
-		whichList[parentX][parentY] = inClosedList;						// add item to the closed list
-		numberOfClosedListItems++;
-		closedList[numberOfClosedListItems] = openList[1];
-		IntPair currCell = IntPair(openList[1].GetX(), openList[1].GetY());
-		DeleteTopItemFromBinaryHeap(openList, numberOfOpenListItems);	// delete this item from the open list
+		whichList[parentX][parentY] = inClosedList;		// add item to the closed list
+		closedList.Push(openList.Top());
+		IntPair currCell = IntPair(openList.Top().GetX(), openList.Top().GetY());
+		openList.Pop();									// delete this item from the open list
 
-		//copy(openList, openList + numberOfOpenListItems + 1, currOpenList);
-		currNumberOfOpenedItems = numberOfOpenListItems;
-		//copy(closedList, closedList + numberOfOpenListItems + 1, currClosedList);
-		currNumberOfClosedItems = numberOfClosedListItems;
-		int next = Step(currCell, Gcost + 1, currOpenList, currNumberOfOpenedItems, whichList, parent, 
-			target, currClosedList, currNumberOfClosedItems);
+		currOpenList = openList;
+		currClosedList = closedList;
+		int next = Step(currCell, Gcost + 1, currOpenList, whichList, parent, target, currClosedList);
 
 		if (next == 0) {
 			mine = snapshot;	// load snapshot
@@ -458,40 +553,21 @@ int Simulator::Step(IntPair cell, int Gcost, OpenListItem * openList, int & numb
 			result = found;
 			break;
 		}
-	} while (numberOfOpenListItems != 0);
+	} while (!openList.Empty());
 	
 	return result;
 }
 
-bool Simulator::IsDeadLock(int x, int y)
-{
-	if (!mine.isWalkable(x, y - 1) && !mine.isWalkable(x, y + 1) && mine.GetObject(x - 1, y) == STONE)
-		return true;
-
-	for (int i = x - 1; i > 0; i--) {
-		if (!mine.isWalkable(i, y - 1) && !mine.isWalkable(i, y + 1) && mine.isWalkable(i, y)) {
-			continue;
-		}
-		if (mine.GetObject(i - 1, y) == STONE && mine.isWalkable(i, y))
-			return true;
-	}
-	return false;
-}
-
+// Description: Returns position of the lambda in the list of missed lambdas or -1
 int Simulator::FindMissedLambda(IntPair lambda)
 {
-	for (size_t i = 0; i < missedLambdas.size(); i++) {										// this is the worst method!!!
-		if (missedLambdas.at(i) == lambda) return i;
-	}
-	return -1;
+	return missedLambdas.Find(lambda);
 }
 
+// Description: Checks whether the lambda at the position was collected on the way to another one
 bool Simulator::FindUnexpectedLambda(int index)
 {
-	for (size_t i = 0; i < unexpectedLambdas.size(); i++) {									// this is the worst method!!!
-		if (unexpectedLambdas.at(i) == index) return true;
-	}
-	return false;
+	return unexpectedLambdas[index];
 }
 
 // Description: Moves robot to the target cell
@@ -518,185 +594,109 @@ bool Simulator::MoveRobot(int x, int y)
 }
 
 // Description: Saves current mine state
+//
+// Only the state saved before the current lambda is ever restored, so the journal starts again here
+// and the snapshot is just a mark in it.
 void Simulator::MakeSnapshot()
 {
-	snapshot.push_back(mine);
+	mine.StartJournal();
+	snapshot = mine.MarkJournal();
 }
 
-// Description: Restores last mine state
+// Description: Restores last mine state by undoing the changes recorded since the snapshot
 void Simulator::LoadSnapshot()
 {
-	mine = snapshot.back();
-	snapshot.pop_back();
+	mine.RollbackJournal(snapshot);
 }
 
 
-void Simulator::AddAdjacentCellsToOpenList(OpenListItem * openList, int & numberOfOpenListItems,
-	int parentX, int parentY, int Gcost, int ** whichList, IntPair ** parent, IntPair target, 
-	OpenListItem * closedList, int & numberOfClosedListItems)
+// Description: Checks whether the way from the start to the cell (x; y) goes through the cell (ancestorX; ancestorY).
+// Reopened cells may get a parent which isn't shorter, and making one of their descendants the parent
+// would make the way a loop.
+bool Simulator::IsAncestor(int ancestorX, int ancestorY, int x, int y, IntPair ** parent)
+{
+	for (int steps = mine.GetWidth() * mine.GetHeight(); steps > 0; steps--) {
+		if (x == ancestorX && y == ancestorY) return true;
+		IntPair next = parent[x][y];
+		if (next.first == x && next.second == y) return false;	// the start is its own parent
+		x = next.first;
+		y = next.second;
+	}
+	return true;
+}
+
+void Simulator::AddAdjacentCellsToOpenList(OpenList & openList, int parentX, int parentY, int Gcost,
+	SearchMarks & whichList, IntPair ** parent, IntPair target, ClosedList & closedList)
 {
 	const int inOpenList = 1, inClosedList = 2;	// lists-related constants
 	int index;
 
-	for (int x = parentX - 1; x <= parentX + 1; x++) {
-		for (int y = parentY - 1; y <= parentY + 1; y++) {
-			if ((x != parentX && y != parentY) || (x == parentX && y == parentY))
-				continue;
-
-			// If not off the map (avoiding array-out-of-bounds errors)
-			if (x != -1 && y != -1 && x != mine.GetHeight() && y != mine.GetWidth()) {
-
-				// If not a wall/obstacle square.
-				if (mine.isWalkable(x, y)) {
-
-					if ( !(x == parentX + 1 && y == parentY && mine.GetMap()[parentX - 1][parentY] == STONE) ) {
-
-						// If cell is not already on the open list and is not in the closed list, add it to the open list.
-						if (whichList[x][y] != inOpenList && whichList[x][y] != inClosedList) {
-							numberOfOpenListItems++;					// increment number of items in the heap
-							openList[numberOfOpenListItems].SetX(x);	// record the x and y coordinates of the new item
-							openList[numberOfOpenListItems].SetY(y);
-
-							// Figure out its G cost
-							openList[numberOfOpenListItems].SetGcost(Gcost + 1);
-									
-							// Figure out its H and F costs and parent
-							//parent[x][y].push_back(IntPair(parentX, parentY));				// change the cell's parent
-							parent[x][y].first = parentX;							// change the cell's parent
+	// Only cells which are not walls are listed (avoiding array-out-of-bounds errors)
+	int neighboursNum;
+	const IntPair * neighbours = mine.GetAnalysis()->GetNeighbours(parentX, parentY, neighboursNum);
+	for (int n = 0; n < neighboursNum; n++) {
+		int x = neighbours[n].first;
+		int y = neighbours[n].second;
+
+		// If not a wall/obstacle square.
+		if (mine.isWalkable(x, y)) {
+
+			if ( !(x == parentX + 1 && y == parentY && mine.GetMap()[parentX - 1][parentY] == STONE) ) {
+
+				// If cell is not already on the open list and is not in the closed list, add it to the open list.
+				if (whichList[x][y] != inOpenList && whichList[x][y] != inClosedList) {
+					// Figure out its H and F costs and parent
+					//parent[x][y].push_back(IntPair(parentX, parentY));				// change the cell's parent
+					parent[x][y].first = parentX;							// change the cell's parent
+					parent[x][y].second = parentY;
+					// F cost includes H cost except when we want to use A* algorithm as Dijkstra's algorithm
+					int Hcost = abs(x - target.first) + abs(y - target.second);
+
+					// Move the new open list item to the proper place in the binary heap.
+					openList.Push(OpenListItem(x, y, Gcost + 1, Hcost));
+
+					whichList[x][y] = inOpenList;	// Change whichList value.
+				}
+				// If cell is already on the open list, choose better G and F costs.
+				else if (whichList[x][y] == inOpenList) {
+					index = openList.Find(x, y);
+					Gcost += 1;	// Figure out the G cost of this possible new path
+
+					// If this path is shorter (G cost is lower) then change the parent cell, G cost and F cost. 		
+					if (Gcost < openList[index].GetGcost() && !IsAncestor(x, y, parentX, parentY, parent)) {
+						parent[x][y].first = parentX;		// change the cell's parent
+						parent[x][y].second = parentY;
+						openList.DecreaseGcost(index, Gcost);	// update the costs and cell's position on the open list
+					}
+				}
+				// If cell is already on the closed list and it is not current cell's parent, choose better G and F costs.
+				else if (whichList[x][y] == inClosedList) {
+					int oldParX = parent[parentX][parentY].first;
+					int oldParY = parent[parentX][parentY].second;
+
+					if (oldParX != x || oldParY != y) {
+						Gcost += 1;	// Figure out the G cost of this possible new path
+
+						// Cells closed when the lift got blocked aren't listed, their item is empty
+						int index = closedList.Find(x, y);
+						OpenListItem item = index != -1 ? closedList[index] : OpenListItem();
+
+						if (((item.GetHcost() == 1000000 && item.GetGcost() != Gcost) || 
+							(item.GetHcost() != 1000000 && Gcost <= item.GetGcost() + 1))
+							&& !IsAncestor(x, y, parentX, parentY, parent)) {
+							// If this path is shorter (G cost is lower) then change the parent cell, G cost and F cost. 		
+							parent[x][y].first = parentX;			// change the cell's parent
 							parent[x][y].second = parentY;
-							// F cost includes H cost except when we want to use A* algorithm as Dijkstra's algorithm
-							openList[numberOfOpenListItems].SetHcost( (abs(x - target.first) + abs(y - target.second)) );
-							openList[numberOfOpenListItems].CalculateFcost();	// update the F cost
-									
-							// Move the new open list item to the proper place in the binary heap.
-							BubbleItemInBinaryHeap(openList, numberOfOpenListItems);
+							openList.Push(OpenListItem(x, y, Gcost, abs(x - target.first) + abs(y - target.second)));
 
 							whichList[x][y] = inOpenList;	// Change whichList value.
-						}
-						// If cell is already on the open list, choose better G and F costs.
-						else if (whichList[x][y] == inOpenList) {
-							index = GetItemIndexFromBinaryHeapByCoord(openList, numberOfOpenListItems, x, y);
-							Gcost += 1;	// Figure out the G cost of this possible new path
 
-							// If this path is shorter (G cost is lower) then change the parent cell, G cost and F cost. 		
-							if (Gcost < openList[index].GetGcost()) {
-								parent[x][y].first = parentX;		// change the cell's parent
-								parent[x][y].second = parentY;
-								openList[index].SetGcost(Gcost);	// change the G cost
-								openList[index].CalculateFcost();	// update the F cost
-								BubbleItemInBinaryHeap(openList, index);		// update cell's position on the open list
-							}
+							// Remove from closed list
+							if (index != -1) closedList.Remove(index);
 						}
-						// If cell is already on the closed list and it is not current cell's parent, choose better G and F costs.
-						else if (whichList[x][y] == inClosedList) {
-							int oldParX = parent[parentX][parentY].first;
-							int oldParY = parent[parentX][parentY].second;
-
-							if (oldParX != x || oldParY != y) {
-								Gcost += 1;	// Figure out the G cost of this possible new path
-
-								OpenListItem item;
-								int index = -1;
-								for (int i = 0; i < numberOfClosedListItems; i++) {
-									if (closedList[i].GetX() == x && closedList[i].GetY() == y) {
-										item = closedList[i];
-										index = i;
-										break;
-									}
-								}
-								
-								if ((item.GetHcost() == 1000000 && item.GetGcost() != Gcost) || 
-									(item.GetHcost() != 1000000 && Gcost <= item.GetGcost() + 1)) {
-									// If this path is shorter (G cost is lower) then change the parent cell, G cost and F cost. 		
-									parent[x][y].first = parentX;			// change the cell's parent
-									parent[x][y].second = parentY;
-									numberOfOpenListItems++;
-									openList[numberOfOpenListItems].SetX(x);
-									openList[numberOfOpenListItems].SetY(y);
-									openList[numberOfOpenListItems].SetGcost(Gcost);	// change the G cost
-									openList[numberOfOpenListItems].SetHcost( (abs(x - target.first) + abs(y - target.second)) );
-									openList[numberOfOpenListItems].CalculateFcost();	// update the F cost
-									BubbleItemInBinaryHeap(openList, numberOfOpenListItems);			// update cell's position on the open list
-
-									whichList[x][y] = inOpenList;	// Change whichList value.
-
-									// Remove from closed list
-									closedList[index] = closedList[numberOfClosedListItems];	// move last item to slot #index
-									numberOfClosedListItems--;
-								}
-							}
-						} //if (whichList[x][y] == inClosedList)
 					}
-				} //if (mine.isWalkable(x, y))
-			}
-		} // for (y)
-	} // for (x)
-}
-
-
-
-// Description: Deletes the top item in binary heap and reorder the heap, with the lowest F cost item rising to the top.
-void Simulator::DeleteTopItemFromBinaryHeap(OpenListItem * heap, int & heapLength)
-{
-	heapLength--;								// decrease number of items in heap
-	heap[1] = heap[heapLength + 1];				// move last item up to slot #1
-	SinkItemInBinaryHeap(heap, heapLength, 1);	// move item to the properly position
-	
-}
-
-// Description: Finds the item in the binary heap by cell's coordinates and returns its index.
-int Simulator::GetItemIndexFromBinaryHeapByCoord(OpenListItem * heap, int heapLength, const int & x, const int & y)
-{
-	int index = -1;
-	for (int i = 1; i <= heapLength; i++) {
-		if (heap[i].GetX() == x && heap[i].GetY() == y) {
-			index = i;
-			break;
-		}
-	}
-	return index;
-}
-
-// Description: Bubbles target item to the properly position in binary heap
-void Simulator::BubbleItemInBinaryHeap(OpenListItem * heap, int index)
-{
-	while (index != 1) {	// While item hasn't bubbled to the top
-		// Swap items if child < parent.
-		if (heap[index].GetFcost() <= heap[index/2].GetFcost()) {
-			OpenListItem temp = heap[index/2];
-			heap[index/2] = heap[index];
-			heap[index] = temp;
-			index = index/2;
-		} else break;
-	}
-}
-
-// Description: Sinks target item to the properly position in binary heap
-void Simulator::SinkItemInBinaryHeap(OpenListItem * heap, int heapLength, int index)
-{
-	int curr, next = 1;
-
-	// Repeat the following until the new item in slot #1 sinks to its proper spot in the heap.
-	while (true) {
-		curr = next;		
-		if (2*curr + 1 <= heapLength) {	// if both children exist
-			// Check if the F cost of the parent is greater than each child and select the lowest one.
-			if (heap[curr].GetFcost() >= heap[2*curr].GetFcost()) 
-				next = 2*curr;
-			if (heap[next].GetFcost() >= heap[2*curr + 1].GetFcost())
-				next = 2*curr+1;		
-		} else {
-			if (2*curr <= heapLength) {	// if only child #1 exists
-				// Check if the F cost of the parent is greater than child #1	
-				if (heap[curr].GetFcost() >= heap[2*curr].GetFcost()) 
-					next = 2*curr;
+				} //if (whichList[x][y] == inClosedList)
 			}
-		}
-
-		if (curr != next) {	// if parent's F > one of its children, swap them
-			OpenListItem temp = heap[curr];
-			heap[curr] = heap[next];
-			heap[next] = temp;
-		} else break;		// otherwise, exit loop
-	}
+		} //if (mine.isWalkable(x, y))
+	} // for (n)
 }
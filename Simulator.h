@@ -1,25 +1,42 @@
 #pragma once
 
 #include "Field.h"
+#include "FieldArena.h"
+#include "SearchWorkspace.h"
+#include "JumpSearch.h"
 #include <map>
 
 class Simulator
 {
 	Field mine;
 
-	vector<Field> snapshot;
+	size_t snapshot;	// journal mark of the state saved by MakeSnapshot
 	bool robotIsDead;
 
 	vector<IntPair> path;
-	vector<IntPair> missedLambdas;
-	vector<int> unexpectedLambdas;
+	LambdaSet missedLambdas;
+	vector<bool> unexpectedLambdas;		// flags of lambda positions collected on the way to other lambdas
+	SearchWorkspace workspace;			// memory of SearchWay, allocated once for the map
+	JumpSearch jumps;					// finds the shortest ways and the cells the robot leaves safely
+	vector<IntPair> safeWay;			// the shortest way found by WalkSafeRun
+	size_t expanded;					// cells expanded by all searches
+	int walkDistance;					// safe runs of ways to targets at least this far are walked, 0 turns it off
 public:
 	Simulator(Field & amine);
 	~Simulator(void);
+#ifdef HAS_MOVE_SEMANTICS
+	Simulator(const Simulator & simulator) = default;
+	Simulator(Simulator && simulator) = default;
+	Simulator & operator = (const Simulator & simulator) = default;
+	Simulator & operator = (Simulator && simulator) = default;
+#endif
 
-	vector<IntPair> GetPath();
+	const vector<IntPair> & GetPath();
+	void SetSnapshotBudget(size_t bytes);	// limits memory of the field states saved by a search
+	void SetSafeWalk(int distance);		// walks the safe runs of ways to the targets at least this far, 0 turns it off
+	size_t GetExpandedNodes();
 
-	void StartSimulation(vector<IntPair> waypoints);
+	void StartSimulation(const vector<IntPair> & waypoints);
 
     bool IsLiftBlocked();
     
@@ -27,10 +44,13 @@ private:
 	void UpdateMap();	// updates map according to the rules
 
 	int MoveRobotToTarget(IntPair target);
-	int Step(IntPair cell, int Gcost, OpenListItem * openList, int & numberOfOpenListItems, int ** whichList, 
-		IntPair ** parent, IntPair target, OpenListItem * closedList, int & numberOfClosedListItems);
+	int SearchWay(IntPair target);
+	int WalkSafeRun(IntPair target, IntPair & end);
+	int LoadCellSnapshot(int x, int y);
+	int Step(IntPair cell, int Gcost, OpenList & openList, SearchMarks & whichList, 
+		IntPair ** parent, IntPair target, ClosedList & closedList);
 
-	bool IsDeadLock(int x, int y);
+	bool IsAncestor(int ancestorX, int ancestorY, int x, int y, IntPair ** parent);
 
 	int FindMissedLambda(IntPair lambda);
 	bool FindUnexpectedLambda(int index);
@@ -40,12 +60,6 @@ private:
 	void MakeSnapshot();
 	void LoadSnapshot();
 
-	void AddAdjacentCellsToOpenList(OpenListItem * openList, int & numberOfOpenListItems, int parentX, 
-		int parentY, int Gcost, int ** whichList, IntPair ** parent, IntPair target, 
-		OpenListItem * closedList, int & numberOfClosedListItems);
-
-	void DeleteTopItemFromBinaryHeap(OpenListItem * heap, int & heapLength);
-	int GetItemIndexFromBinaryHeapByCoord(OpenListItem * heap, int heapLength, const int & x, const int & y);
-	void BubbleItemInBinaryHeap(OpenListItem * heap, int index);
-	void SinkItemInBinaryHeap(OpenListItem * heap, int heapLength, int index);
+	void AddAdjacentCellsToOpenList(OpenList & openList, int parentX, int parentY, int Gcost,
+		SearchMarks & whichList, IntPair ** parent, IntPair target, ClosedList & closedList);
 };
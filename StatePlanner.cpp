@@ -0,0 +1,210 @@
+#include "StatePlanner.h"
+#include "Deadline.h"
+#include "DangerMap.h"
+#include <queue>
+
+
+StatePlanner::StatePlanner(Field & amine)
+{
+	this->mine = amine;
+	escaped = false;
+	nodeLimit = PLANNER_NODE_LIMIT;
+	expanded = 0;
+}
+
+StatePlanner::~StatePlanner(void)
+{
+	ReleaseNodes();
+}
+
+void StatePlanner::SetNodeLimit(size_t limit)
+{
+	nodeLimit = limit;
+}
+
+const vector<_Command> & StatePlanner::GetTrace()
+{
+	return this->trace;
+}
+
+size_t StatePlanner::GetExpandedNodes()
+{
+	return this->expanded;
+}
+
+// Description: Visits the waypoints after the robot (waypoint #0) and then the lift
+//
+// Waypoints which can't be reached are tried again after the others while any of them is collected,
+// since collecting a lambda may move the rocks which were in the way.
+void StatePlanner::StartPlanning(const vector<IntPair> & waypoints)
+{
+	FieldArena arena;	// tiles of the states are reused by the searches and freed when planning ends
+
+	vector<IntPair> targets;
+	for (size_t i = 1; i < waypoints.size(); i++) {
+		if (waypoints[i] != mine.GetLift()) targets.push_back(waypoints[i]);
+	}
+
+	bool progress = true;
+	while (progress && !targets.empty() && !Deadline::Expired()) {
+		progress = false;
+		vector<IntPair> missed;
+		for (size_t i = 0; i < targets.size(); i++) {
+			// Lambdas collected on the way to other ones aren't visited again
+			if (mine.FindLambda(targets[i]) == -1) continue;
+			if (MoveRobotToTarget(targets[i])) progress = true;
+			else missed.push_back(targets[i]);
+		}
+		targets.swap(missed);
+	}
+
+	// The lift opens only when all lambdas are collected
+	if (mine.GetLambdasNum() == 0 || mine.isLiftOpened()) MoveRobotToTarget(mine.GetLift());
+
+	if (!escaped) trace.push_back(ABORT);
+}
+
+// Description: Makes the command on the field by the rules of the game and updates the map
+// Returns: false if the robot can't move to the cell or dies
+bool StatePlanner::MoveRobot(Field & field, _Command command)
+{
+	int xold = field.GetRobot().first;
+	int yold = field.GetRobot().second;
+	int x = xold, y = yold;
+
+	switch (command) {
+	case RIGHT:
+		y++;
+		break;
+	case LEFT:
+		y--;
+		break;
+	case UP:
+		x--;
+		break;
+	case DOWN:
+		x++;
+		break;
+	}
+
+	if (command != WAIT) {
+		if (!field.isWalkable(x, y)) return false;
+
+		if (field.GetObject(x, y) == STONE) {
+			field.SetObject(x, 2 * y - yold, STONE);	// the stone is pushed to the next cell
+		} else if (field.GetObject(x, y) == LAMBDA) {
+			field.EraseLambda(IntPair(x, y));
+		}
+		field.SetObject(xold, yold, EMPTY);
+		field.SetObject(x, y, ROBOT);
+		field.SetRobot(x, y);
+	}
+	field.UpdateMap();
+
+	return !field.IsRobotDead();
+}
+
+// Description: Finds the shortest sequence of commands bringing the robot to the target alive
+// and makes it on the mine
+// Returns: false if the target isn't reached within the node limit
+bool StatePlanner::MoveRobotToTarget(IntPair target)
+{
+	const _Command commands[] = { UP, LEFT, RIGHT, DOWN, WAIT };
+	const int commandsNum = 5;
+
+	priority_queue<OpenNode> openList;
+	table.Clear();
+
+	int start = AddNode(-1, WAIT, 0, new Field(mine));
+	table.Update(nodes[start].hash, 0, start);
+	OpenNode item;
+	item.Fcost = abs(mine.GetRobot().first - target.first) + abs(mine.GetRobot().second - target.second);
+	item.Gcost = 0;
+	item.node = start;
+	openList.push(item);
+
+	int found = -1;
+	size_t expandedNodes = 0;
+
+	while (!openList.empty() && expandedNodes < nodeLimit && !Deadline::Expired()) {
+		int current = openList.top().node;
+		openList.pop();
+
+		// The state was reached again at lower cost after this item was listed
+		if (!nodes[current].field) continue;
+
+		Field * field = nodes[current].field;
+		if (field->GetRobot() == target) {
+			found = current;
+			break;
+		}
+
+		nodes[current].field = NULL;
+		expandedNodes++;
+
+		for (int i = 0; i < commandsNum; i++) {
+			if (DangerMap::IsLethalMove(*field, commands[i])) continue;
+
+			Field * next = new Field(*field);
+			if (!MoveRobot(*next, commands[i])) {
+				delete next;
+				continue;
+			}
+
+			int Gcost = nodes[current].Gcost + 1;
+			int old = table.Find(next->GetHash());
+			if (!table.Update(next->GetHash(), Gcost, nodes.size())) {
+				delete next;
+				continue;
+			}
+
+			// The node listed for the state at higher cost is never expanded
+			if (old != -1 && nodes[old].field) {
+				delete nodes[old].field;
+				nodes[old].field = NULL;
+			}
+
+			int node = AddNode(current, commands[i], Gcost, next);
+			item.Fcost = Gcost + abs(next->GetRobot().first - target.first) + abs(next->GetRobot().second - target.second);
+			item.Gcost = Gcost;
+			item.node = node;
+			openList.push(item);
+		}
+		delete field;
+	}
+	expanded += expandedNodes;
+
+	bool result = found != -1;
+	if (result) {
+		// Commands are collected backwards from the found node
+		size_t first = trace.size();
+		for (int node = found; nodes[node].parent != -1; node = nodes[node].parent)
+			trace.push_back(nodes[node].command);
+		reverse(trace.begin() + first, trace.end());
+
+		mine = *nodes[found].field;
+		escaped = mine.GetRobot() == mine.GetLift();
+	}
+
+	ReleaseNodes();
+	return result;
+}
+
+int StatePlanner::AddNode(int parent, _Command command, int Gcost, Field * field)
+{
+	Node node;
+	node.parent = parent;
+	node.command = command;
+	node.Gcost = Gcost;
+	node.hash = field->GetHash();
+	node.field = field;
+	nodes.push_back(node);
+	return nodes.size() - 1;
+}
+
+void StatePlanner::ReleaseNodes()
+{
+	for (size_t i = 0; i < nodes.size(); i++)
+		delete nodes[i].field;
+	nodes.clear();
+}
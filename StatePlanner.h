@@ -0,0 +1,62 @@
+#pragma once
+
+#include "stdafx.h"
+#include "Field.h"
+#include "FieldArena.h"
+#include "TranspositionTable.h"
+
+// Planner which searches over whole game states instead of robot cells.
+// The waypoints are visited in the given order; the way to every one of them is found by A*
+// whose nodes are states of the mine reached by U, D, L, R and W commands, so the robot can wait
+// for rocks to fall. States reached again at no lower cost are found in the transposition table
+// by the hash of the mine. A search expanding more than the node limit gives the waypoint up.
+class StatePlanner
+{
+	// State reached by the command from the parent node
+	struct Node
+	{
+		int parent;			// -1 for the start node
+		_Command command;
+		int Gcost;
+		_StateHash hash;
+		Field * field;		// state of the node until it is expanded, NULL afterwards
+	};
+
+	// Item of the open list, the lowest F cost first and the deepest one among equal F costs
+	struct OpenNode
+	{
+		int Fcost;
+		int Gcost;
+		int node;
+		bool operator < (const OpenNode & item) const
+		{
+			return Fcost != item.Fcost ? Fcost > item.Fcost : Gcost < item.Gcost;
+		}
+	};
+
+	Field mine;
+	vector<_Command> trace;
+	bool escaped;			// the robot has reached the opened lift
+
+	vector<Node> nodes;
+	TranspositionTable table;
+	size_t nodeLimit;
+	size_t expanded;		// nodes expanded by all searches
+
+public:
+	StatePlanner(Field & amine);
+	~StatePlanner(void);
+
+	void SetNodeLimit(size_t limit);	// limits nodes expanded by the search for one waypoint
+	void StartPlanning(const vector<IntPair> & waypoints);
+
+	const vector<_Command> & GetTrace();	// commands of the plan, ABORT is added if the lift isn't reached
+	size_t GetExpandedNodes();
+
+	static bool MoveRobot(Field & field, _Command command);	// returns false if the robot can't move or dies
+
+private:
+	bool MoveRobotToTarget(IntPair target);
+	int AddNode(int parent, _Command command, int Gcost, Field * field);
+	void ReleaseNodes();
+};
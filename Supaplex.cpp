@@ -2,10 +2,25 @@
 //
 
 #include "Game.h"
+#include "StatePlanner.h"
+#include "Deadline.h"
+#include "DangerMap.h"
+#include <sstream>
+#include <stdlib.h>
+#include <time.h>
 
 const int iterations = 0;
+const int checkTicks = 2000;	// number of random moves made on every map by cross-check
+const int checkSettleTicks = 16;	// limit of ticks for Field::Settle in cross-check
 
-void start(istream & sin);
+int start(const char * fileName, int backend, int storage, size_t budget, int walk, int planner, int size, int tours, int threads, double timeLimit);
+void interrupt(int signalNumber);
+int check(const char * fileName);
+bool checkSettle(Field * mine);
+void referenceMove(Field & field, _Command command);
+bool referenceUpdate(Field & field);
+int bench(const char * fileName);
+int score(const char * fileName, const vector<_Command> & trace);
 
 
 int main(int argc, char* argv[])
@@ -13,31 +28,349 @@ int main(int argc, char* argv[])
 //	ofstream fout("..//IO files//output.txt");
 //	fout.close();
 
-	ifstream fin;
-	if (argc == 2) {
-		fin.open(argv[1]);
-		if (!fin.is_open()) {
+	int backend = GRID_BACKEND;
+	int storage = FIELD_DEFAULT_STORAGE;
+	size_t budget = SEARCH_SNAPSHOT_BUDGET;
+	int walk = SAFE_WALK_MIN_DISTANCE;
+	int planner = CELL_PLANNER;
+	int size = 0;		// beam width or rollouts per command
+	int threads = 0;
+	int tours = TOUR_CANDIDATES;
+	double timeLimit = 0;	// seconds, 0 solves without a limit
+	int argi = 1;
+
+	if (argi < argc && string(argv[argi]) == "-c") {
+		// Cross-check of the backends on every map from the command line
+		if (argc == 2) {
+			cout << "Usage: supaplex -c map_file..." << endl;
+			return -2;
+		}
+		int result = 0;
+		for (argi++; argi < argc; argi++) {
+			if (check(argv[argi]) != 0) result = -1;
+		}
+		return result;
+	}
+
+	if (argi < argc && string(argv[argi]) == "-t") {
+		// Comparison of the planners on every map from the command line
+		if (argc == 2) {
+			cout << "Usage: supaplex -t map_file..." << endl;
+			return -2;
+		}
+		int result = 0;
+		for (argi++; argi < argc; argi++) {
+			if (bench(argv[argi]) != 0) result = -1;
+		}
+		return result;
+	}
+
+	for (; argi < argc; argi++) {
+		if (string(argv[argi]) == "-b") {
+			backend = BITBOARD_BACKEND;
+		} else if (string(argv[argi]) == "-p") {
+			storage = PACKED_STORAGE;
+		} else if (string(argv[argi]) == "-s") {
+			planner = STATE_PLANNER;
+		} else if (string(argv[argi]) == "-w" && argi + 1 < argc) {
+			planner = BEAM_PLANNER;
+			size = atoi(argv[++argi]);
+		} else if (string(argv[argi]) == "-r" && argi + 1 < argc) {
+			planner = MCTS_PLANNER;
+			size = atoi(argv[++argi]);
+		} else if (string(argv[argi]) == "-n" && argi + 1 < argc) {
+			tours = atoi(argv[++argi]);
+		} else if (string(argv[argi]) == "-j" && argi + 1 < argc) {
+			threads = atoi(argv[++argi]);
+		} else if (string(argv[argi]) == "-m" && argi + 1 < argc) {
+			budget = (size_t) atol(argv[++argi]) << 20;	// megabytes
+		} else if (string(argv[argi]) == "-a" && argi + 1 < argc) {
+			walk = atoi(argv[++argi]);
+		} else if (string(argv[argi]) == "--time-limit" && argi + 1 < argc) {
+			timeLimit = atof(argv[++argi]);
+		} else {
+			break;
+		}
+	}
+
+	if (argc - argi == 1) {
+		return start(argv[argi], backend, storage, budget, walk, planner, size, tours, threads, timeLimit);
+	} else if (argc - argi != 0) {
+		cout << "Usage: supaplex [-b] [-p] [-n tours | -s | -w beam_width | -r rollouts] [-j threads] [-m megabytes]" << endl;
+		cout << "                [-a walk_distance] [--time-limit seconds] [input_file]" << endl;
+		cout << "       supaplex -c map_file..." << endl;
+		cout << "       supaplex -t map_file..." << endl;
+		return -2;
+	}
+
+	return start(NULL, backend, storage, budget, walk, planner, size, tours, threads, timeLimit);
+}
+
+// Description: Solves the map from the file or from standard input if fileName is NULL.
+// With a time limit the trace keeps improving until the limit; SIGINT or SIGTERM ends solving
+// at once, and the best trace found so far is printed.
+// Returns: 0 if the map is solved, -1 if the file can't be opened
+int start(const char * fileName, int backend, int storage, size_t budget, int walk, int planner, int size, int tours, int threads, double timeLimit) {
+	if (timeLimit > 0) Deadline::SetTimeLimit(timeLimit);
+	signal(SIGINT, interrupt);
+	signal(SIGTERM, interrupt);
+
+	Game game;
+	if (fileName) {
+		if (game.Init(fileName) == -1) {
 			cout << "Can't open file." << endl;
 			return -1;
 		}
-		start(fin);
-	} else if (argc != 1) {
-		cout << "Usage: supaplex [input_file]" << endl;
-		return -2;
-	} else {
-		start(cin);
+	} else if (game.Init(cin) == -1) {
+		return 0;
 	}
 
+	game.GetField()->SetBackend(backend);
+	game.GetField()->SetStorage(storage);
+	game.SetSnapshotBudget(budget);
+	game.SetSafeWalk(walk);
+	game.SetPlanner(planner);
+	if (planner == BEAM_PLANNER) game.SetBeam(size, threads);
+	if (planner == MCTS_PLANNER) game.SetMcts(size, threads);
+	if (planner == CELL_PLANNER) game.SetTours(tours, threads);
+	game.SetTraceThreads(threads);
+	game.Solve(iterations);
+	const vector<_Command> & trace = game.GetTrace();
+	cout.write(trace.empty() ? "" : &trace[0], trace.size());
+	cout << endl;
 	return 0;
 }
 
-void start(istream & sin) {
-	Game game;
-	if (game.Init(sin) != -1) {
-		game.Solve(iterations);
-		for (size_t i = 0; i < game.GetTrace().size(); i++) {
-			cout << game.GetTrace()[i];
+// Description: Ends the budget of solving; a second signal kills the program
+void interrupt(int signalNumber) {
+	Deadline::Interrupt();
+	signal(signalNumber, SIG_DFL);
+}
+
+// Description: Plays the same random moves with both backends, with packed storage, with
+// the rules of StatePlanner and with the original full scan update and compares the mines after
+// every move. Deaths are also foretold by the danger map's check of the move
+// Returns: 0 if the mines are always the same, -1 otherwise
+int check(const char * fileName) {
+	ifstream fin(fileName);
+	if (!fin.is_open()) {
+		cout << fileName << ": can't open file." << endl;
+		return -1;
+	}
+	stringstream buf;
+	buf << fin.rdbuf();
+
+	const _Command commands[] = { UP, DOWN, LEFT, RIGHT, WAIT };
+	Game grid, bitboard, packed;
+	Field planned, reference;
+	srand(1);
+
+	for (int tick = 0; tick < checkTicks; tick++) {
+		// Start again when the game is over
+		if (tick == 0 || grid.GetResult() != 0) {
+			istringstream sin1(buf.str()), sin2(buf.str()), sin3(buf.str());
+			grid.GetField()->SetStorage(BYTE_STORAGE);
+			grid.Init(sin1);
+			bitboard.Init(sin2);
+			bitboard.GetField()->SetBackend(BITBOARD_BACKEND);
+			packed.GetField()->SetStorage(PACKED_STORAGE);
+			packed.Init(sin3);
+			planned = *grid.GetField();
+			reference = planned;
+		}
+
+		_Command command = commands[rand() % 5];
+		grid.MoveRobot(command);
+		bitboard.MoveRobot(command);
+		packed.MoveRobot(command);
+		// The game makes a move into a cell the robot can't enter as a wait
+		Field before = planned;
+		bool lethal = DangerMap::IsLethalMove(before, command);
+		if (!StatePlanner::MoveRobot(planned, command) && !planned.IsRobotDead()) {
+			lethal = DangerMap::IsLethalMove(before, WAIT);
+			StatePlanner::MoveRobot(planned, WAIT);
+		}
+		referenceMove(reference, command);
+		bool referenceDied = referenceUpdate(reference);
+
+		ostringstream out1, out2, out3, out4, out5;
+		grid.GetField()->SaveMap(out1);
+		bitboard.GetField()->SaveMap(out2);
+		packed.GetField()->SaveMap(out3);
+		planned.SaveMap(out4);
+		reference.SaveMap(out5);
+		if (out1.str() != out2.str() || grid.GetResult() != bitboard.GetResult()
+			|| out1.str() != out4.str() || grid.GetField()->GetHash() != planned.GetHash()
+			|| out1.str() != out3.str() || grid.GetResult() != packed.GetResult()
+			|| grid.GetField()->GetHash() != packed.GetField()->GetHash()
+			|| bitboard.GetField()->CheckBitField() != 0
+			|| grid.GetField()->GetHash() != grid.GetField()->ComputeHash()
+			|| grid.GetField()->GetHash() != bitboard.GetField()->GetHash()
+			|| lethal != planned.IsRobotDead()
+			|| out1.str() != out5.str() || referenceDied != planned.IsRobotDead()) {
+				cout << fileName << ": FAILED at move " << tick << endl;
+				return -1;
+		}
+		if (!checkSettle(grid.GetField())) {
+			cout << fileName << ": settling FAILED at move " << tick << endl;
+			return -1;
+		}
+	}
+
+	cout << fileName << ": OK" << endl;
+	return 0;
+}
+
+// Description: Settles a copy of the mine and compares it with a copy updated tick by tick
+// Returns: true if the copies are the same and the settled mine is really stable
+bool checkSettle(Field * mine) {
+	Field settled = *mine, ticked = *mine;
+	bool robotDied;
+	int ticks = settled.Settle(checkSettleTicks, robotDied);
+	for (int i = 0; i < ticks; i++) {
+		ticked.UpdateMap();
+	}
+
+	ostringstream out1, out2;
+	settled.SaveMap(out1);
+	ticked.SaveMap(out2);
+	if (out1.str() != out2.str() || robotDied != ticked.IsRobotDead())
+		return false;
+
+	// Nothing may move after settling unless the limit was reached or the robot died
+	if (ticks < checkSettleTicks && !robotDied) {
+		_StateHash hash = ticked.GetHash();
+		ticked.UpdateMap();
+		if (ticked.GetHash() != hash || ticked.IsRobotDead())
+			return false;
+	}
+	return true;
+}
+
+// Description: Moves the robot like the game does without updating the map; a move into a cell
+// the robot can't enter is a wait
+void referenceMove(Field & field, _Command command) {
+	int xold = field.GetRobot().first;
+	int yold = field.GetRobot().second;
+	int x = xold, y = yold;
+
+	switch (command) {
+	case RIGHT:
+		y++;
+		break;
+	case LEFT:
+		y--;
+		break;
+	case UP:
+		x--;
+		break;
+	case DOWN:
+		x++;
+		break;
+	}
+
+	if (command == WAIT || !field.isWalkable(x, y)) return;
+	if (field.GetObject(x, y) == STONE) {
+		field.SetObject(x, 2 * y - yold, STONE);
+	} else if (field.GetObject(x, y) == LAMBDA) {
+		field.EraseLambda(IntPair(x, y));
+	}
+	field.SetObject(xold, yold, EMPTY);
+	field.SetObject(x, y, ROBOT);
+	field.SetRobot(x, y);
+}
+
+// Description: Updates the map by the original rules: every cell is scanned and read from the map
+// as it was before the update, the moved rocks are written after the scan
+// Returns: true if a rock lands on the cell above the robot
+bool referenceUpdate(Field & field) {
+	// The copy of the map is framed by walls, so the rules read the cells around every rock
+	int height = field.GetHeight(), width = field.GetWidth(), stride = width + 2;
+	vector<_MineObject> map((height + 3) * stride, WALL);
+	_MineObject * cells = &map[stride + 1];		// the cell (i; j) is cells[i * stride + j]
+	for (int i = 0; i < height; i++) {
+		for (int j = 0; j < width; j++) {
+			cells[i * stride + j] = field.GetObject(i, j);
+		}
+	}
+
+	vector<_MineObject> newState(height * width, WALL);	// WALL keeps the cell
+	bool robotDied = false;
+	for (int i = 0; i < height; i++) {
+		for (int j = 0; j < width; j++) {
+			const _MineObject * rock = cells + i * stride + j;
+			const _MineObject * below = rock + stride;
+			if (*rock != STONE) continue;
+
+			int shift;		// the rock moves to the cell below shifted by it
+			if (below[0] == EMPTY)
+				shift = 0;
+			else if (below[0] == STONE && rock[1] == EMPTY && below[1] == EMPTY)
+				shift = 1;
+			else if (below[0] == STONE && rock[-1] == EMPTY && below[-1] == EMPTY)
+				shift = -1;
+			else if (below[0] == LAMBDA && rock[1] == EMPTY && below[1] == EMPTY)
+				shift = 1;
+			else
+				continue;
+
+			newState[i * width + j] = EMPTY;
+			newState[(i + 1) * width + j + shift] = STONE;
+			if (below[stride + shift] == ROBOT) robotDied = true;
 		}
-		cout << endl;
 	}
+
+	for (int i = 0; i < height; i++) {
+		for (int j = 0; j < width; j++) {
+			if (newState[i * width + j] != WALL) field.SetObject(i, j, newState[i * width + j]);
+		}
+	}
+	if (field.GetLambdasNum() == 0) {
+		field.SetLiftState(true);
+		field.SetObject(field.GetLift().first, field.GetLift().second, OPENED_LIFT);
+	}
+	return robotDied;
+}
+
+// Description: Solves the map with every planner and prints nodes expanded (rollouts made by MCTS),
+// processor time and score of each
+// Returns: 0 if the map is solved, -1 if the file can't be opened
+int bench(const char * fileName) {
+	const int planners[] = { CELL_PLANNER, STATE_PLANNER, BEAM_PLANNER, MCTS_PLANNER };
+	const char * names[] = { "cells", "states", "beam", "mcts" };
+	const int plannersNum = 4;
+
+	cout << fileName << ":";
+	for (int i = 0; i < plannersNum; i++) {
+		Game game;
+		if (game.Init(fileName) == -1) {
+			cout << " can't open file." << endl;
+			return -1;
+		}
+		game.SetPlanner(planners[i]);
+
+		clock_t startTime = clock();
+		game.Solve(iterations);
+		double seconds = (double) (clock() - startTime) / CLOCKS_PER_SEC;
+
+		cout << " " << names[i] << " " << game.GetSearchNodes() << (planners[i] == MCTS_PLANNER ? " rollouts " : " nodes ")
+			<< seconds << " s score " << score(fileName, game.GetTrace());
+		// Processor time of all threads is measured, so this is the rate of one processor
+		if (planners[i] == MCTS_PLANNER)
+			cout << " " << (seconds > 0 ? game.GetSearchNodes() / seconds : 0) << " rollouts/s/core";
+		cout << (i < plannersNum - 1 ? ";" : "");
+	}
+	cout << endl;
+	return 0;
+}
+
+// Description: Plays the trace on the map from the file
+// Returns: score of the game
+int score(const char * fileName, const vector<_Command> & trace) {
+	Game game;
+	game.Init(fileName);
+	for (size_t i = 0; i < trace.size() && game.GetResult() == 0; i++) {
+		game.MoveRobot(trace[i]);
+	}
+	return game.GetScore();
 }
@@ -1,17 +1,28 @@
 #include "TSPSolver.h"
+#include "Deadline.h"
+#include <stdlib.h>
 
 
 TSPSolver::TSPSolver(Field * amine)
 {
 	this->mine = amine;
+	walking = false;
 
 	if (!mine->GetLambdas().empty()) {
+		const vector<IntPair> & lambdas = mine->GetLambdas();
 		nodes.push_back(mine->GetRobot());
-		for (int i = 0; i < (int) mine->GetLambdas().size(); i++) {
-			nodes.push_back(mine->GetLambdas().at(i));
+		for (size_t i = 0; i < lambdas.size(); i++) {
+			// Lambdas separated from the robot by walls are never visited
+			if (mine->GetAnalysis()->IsLambdaReachable(lambdas[i]))
+				nodes.push_back(lambdas[i]);
 		}
 		nodes.push_back(mine->GetLift());
 	}
+
+	jumpsPrepared = false;
+	wallsPrepared = false;
+	if (TOUR_WALK_CANDIDATES > 0 && nodes.size() <= TOUR_WALK_NODES)
+		walkDistances.assign(nodes.size() * nodes.size(), -1);
 }
 
 TSPSolver::~TSPSolver(void)
@@ -19,7 +30,7 @@ TSPSolver::~TSPSolver(void)
 }
 
 // Description: Returns result path as sequence of cells's coordinates
-vector<IntPair> TSPSolver::GetTourPath()
+const vector<IntPair> & TSPSolver::GetTourPath()
 {
 	return this->path;
 }
@@ -46,13 +57,13 @@ vector<IntPair> TSPSolver::GetPath(const int & start, const int & target)
 }
 
 // Description: Returns nodes
-vector<IntPair> TSPSolver::GetNodes()
+const vector<IntPair> & TSPSolver::GetNodes()
 {
 	return this->nodes;
 }
 
 // Description: Returns tour, i.e. nodes order in path
-vector<int> TSPSolver::GetTour()
+const vector<int> & TSPSolver::GetTour()
 {
 	return this->tour;
 }
@@ -63,9 +74,35 @@ int TSPSolver::GetTourDistance()
 	return this->tourDistance;
 }
 
-// Description: Solves TSP problem
-void TSPSolver::Solve(const int & iterations)
+// Description: Solves TSP problem. With candidatesNum > 1 other tours are kept as candidates
+// after the found one: the found tour improved by 2-opt on small maps, nearest neighbour tours
+// which sometimes take a farther node and the found tour with random segments reversed
+void TSPSolver::Solve(const int & iterations, size_t candidatesNum)
+{
+	candidates.clear();
+	if (nodes.size() == 0) {
+		candidates.push_back(nodes);
+		return;
+	}
+
+	walking = false;
+	FindCandidates(iterations, candidatesNum);
+
+	// Walls make some Manhattan tours long, tours by walked distances are tried too
+	if (candidatesNum > 1 && !walkDistances.empty() && !Deadline::Expired()) {
+		walking = true;
+		FindCandidates(iterations, candidates.size() + TOUR_WALK_CANDIDATES);
+		walking = false;
+	}
+
+	nodes = candidates[0];
+	walkDistances.assign(walkDistances.size(), -1);		// distances follow the indexes of the nodes
+}
+
+// Description: Finds a tour by the current distances and adds it and other tours to the candidates
+void TSPSolver::FindCandidates(const int & iterations, size_t candidatesNum)
 {
+	tour.clear();
 	//SetMatrixes();				// initialize distance and path matrixes
 	CreateNearestNeighbourTour();	// create tour using NN algorithm
 
@@ -75,7 +112,7 @@ void TSPSolver::Solve(const int & iterations)
 	//cout << endl;
 
 
-	for (int i = 0; i < iterations; i++)
+	for (int i = 0; i < iterations && !Deadline::Expired(); i++)
 		StartTwoOpt();					// optimize the found tour
 
 	//for (int i = 0; i < tour.size(); i++) {
@@ -86,18 +123,45 @@ void TSPSolver::Solve(const int & iterations)
 	//SetTourPath();					// build result path as sequence of cells's coordinates
 
 
-	if (nodes.size() == 0) return;
-
-	vector<IntPair> tmp;
-	for (size_t i = 0; i < tour.size(); i++) {
-		tmp.push_back(nodes.at(tour.at(i)));
+	vector<int> found = tour;
+	AddCandidate(found);
+	if (candidatesNum > 1 && nodes.size() <= TOUR_TWO_OPT_NODES) {
+		StartTwoOpt();
+		AddCandidate(tour);
+		tour = found;
 	}
-	nodes.clear();
-	for (size_t i = 0; i < tmp.size(); i++) {
-		nodes.push_back(tmp.at(i));
+
+	// Small maps have few different tours, so the attempts are limited
+	unsigned seed = 1;
+	for (size_t k = 1; candidates.size() < candidatesNum && k < 4 * candidatesNum && !Deadline::Expired(); k++) {
+		vector<int> candidate;
+		if (k % 2) {
+			CreateRandomNeighbourTour(candidate, seed);
+		} else {
+			candidate = found;
+			PerturbTour(candidate, 1 + k / 8, seed);
+		}
+		AddCandidate(candidate);
 	}
 }
 
+// Description: Returns orders of the nodes to simulate, the found tour is the first one
+const vector< vector<IntPair> > & TSPSolver::GetCandidates()
+{
+	return this->candidates;
+}
+
+// Description: Keeps the nodes in the order of the tour unless the same order is kept already
+void TSPSolver::AddCandidate(const vector<int> & order)
+{
+	vector<IntPair> candidate;
+	for (size_t i = 0; i < order.size(); i++)
+		candidate.push_back(nodes.at(order.at(i)));
+
+	if (find(candidates.begin(), candidates.end(), candidate) == candidates.end())
+		candidates.push_back(candidate);
+}
+
 // Description: Calculates matrix of distances and matrix of paths between lambdas
 void TSPSolver::SetMatrixes()
 {
@@ -189,7 +253,26 @@ int TSPSolver::GetDistance(const int & node1, const int & node2)
 	int startY = nodes.at(start).second;
 	int targetX = nodes.at(target).first;
 	int targetY = nodes.at(target).second;
-	return (abs(startX - targetX) + abs(startY - targetY));
+	int manhattan = abs(startX - targetX) + abs(startY - targetY);
+	if (!walking) return manhattan;
+
+	// One search walks the distances from the start to all nodes, the distance to itself tells it is done
+	int * row = &walkDistances[start * nodes.size()];
+	if (row[start] == -1) {
+		vector<int> distances;
+		PrepareJumps();
+		jumps.FindDistances(nodes[start], nodes, distances);
+		if (find(distances.begin(), distances.end(), -1) != distances.end()) {
+			// Rocks shut off the node now but fall or are pushed away later, the way around walls estimates it
+			vector<int> wallDistances;
+			PrepareWalls();
+			wallJumps.FindDistances(nodes[start], nodes, wallDistances);
+			for (size_t i = 0; i < distances.size(); i++)
+				if (distances[i] == -1) distances[i] = wallDistances[i];
+		}
+		copy(distances.begin(), distances.end(), row);
+	}
+	return row[target] == -1 ? manhattan : row[target];
 }
 
 // Description: Stores tour distance
@@ -232,6 +315,62 @@ void TSPSolver::CreateNearestNeighbourTour()
 	}
 }
 
+// Description: Builds the tour like CreateNearestNeighbourTour, but one of the TOUR_NEIGHBOUR_CHOICES
+// nearest nodes is taken instead of the nearest one: the nearest with probability 1/2, the next with 1/4...
+// The robot starts the tour and the lift ends it.
+void TSPSolver::CreateRandomNeighbourTour(vector<int> & order, unsigned & seed)
+{
+	int nodeNum = nodes.size();
+	vector<int> nodeList;
+	for (int i = 1; i < nodeNum - 1; i++)
+		nodeList.push_back(i);
+
+	int node = 0;
+	order.push_back(node);
+	while (!nodeList.empty()) {
+		// Indexes in nodeList of the nearest nodes and their distances, the nearest first
+		int nearest[TOUR_NEIGHBOUR_CHOICES], nearestDist[TOUR_NEIGHBOUR_CHOICES];
+		int nearestNum = 0;
+		for (int i = 0; i < (int) nodeList.size(); i++) {
+			int dist = GetDistance(node, nodeList[i]);
+			int k = nearestNum;
+			if (k == TOUR_NEIGHBOUR_CHOICES) {
+				if (dist >= nearestDist[k - 1]) continue;
+				k--;			// the farthest one is dropped
+			} else {
+				nearestNum++;
+			}
+			for (; k > 0 && nearestDist[k - 1] > dist; k--) {
+				nearest[k] = nearest[k - 1];
+				nearestDist[k] = nearestDist[k - 1];
+			}
+			nearest[k] = i;
+			nearestDist[k] = dist;
+		}
+
+		int choice = 0;
+		while (choice < nearestNum - 1 && rand_r(&seed) % 2) choice++;
+		node = nodeList[nearest[choice]];
+		order.push_back(node);
+		nodeList.erase(nodeList.begin() + nearest[choice]);
+	}
+	order.push_back(nodeNum - 1);
+}
+
+// Description: Reverses random segments of the tour between the robot and the lift
+void TSPSolver::PerturbTour(vector<int> & order, int reversals, unsigned & seed)
+{
+	int lambdasNum = order.size() - 2;
+	if (lambdasNum < 2) return;
+
+	for (int r = 0; r < reversals; r++) {
+		int first = 1 + rand_r(&seed) % lambdasNum;
+		int last = 1 + rand_r(&seed) % lambdasNum;
+		if (first > last) swap(first, last);
+		reverse(order.begin() + first, order.begin() + last + 1);
+	}
+}
+
 // Description: Returns the nearest node concerning the specified node
 int TSPSolver::GetNearestNeighbour(const int & node, set<int> & nodeSet)
 {
@@ -264,7 +403,7 @@ void TSPSolver::StartTwoOpt()
 {
 	int size = tour.size();
 
-	for ( int i = 0; i < size - 3; i++ ) {
+	for ( int i = 0; i < size - 3 && !Deadline::Expired(); i++ ) {
 		for ( int j = i + 3; j < size - 1; j++ ) {
 			TwoOpt(i, i + 1, j, j + 1);		// use 2-opt algorithm with selected nodes
 		}
@@ -301,252 +440,41 @@ void TSPSolver::TwoOpt(const int & startN1Index, const int & targetN1Index,
 }
 
 
-// Description: Finds a path using A*.
-vector<IntPair> TSPSolver::FindPath(int startX, int startY, int targetX, int targetY, bool useHcost)
+// Description: Finds a path by jump search around rocks or, if rocks shut the target off, around walls alone;
+// cells of the straight runs are filled in
+vector<IntPair> TSPSolver::FindPath(int startX, int startY, int targetX, int targetY)
 {
 	vector<IntPair> resultPath;			// vector of coordinates of cells in found path
-	int path = 0;
-	const int nonexistent = 0, found = 1;		// path-related constants
-	const int inOpenList = 1, inClosedList = 2;	// lists-related constants
-	int parentX, parentY, Gcost, index;
-	int ** whichList;			// used to record whether a cell is on the open list or on the closed list.
-	IntPair ** parent;	// used to record parent of each cage
-	OpenListItem * openList;	// array holding open list items, which is maintained as a binary heap.
-	int numberOfOpenListItems;
-
-// 1. Checking start and target cells to avoid misunderstandings.
-
-	// If start and target cells are the same cell
-	if (startX == targetX && startY == targetY) {
-		resultPath.push_back(IntPair (startX, startY));
-		return resultPath;
-	}
-
-	// If target cell is unwalkable
-	if (mine->GetMap()[targetX][targetY] == '#') {
-		resultPath.push_back(IntPair (-1, -1));	// its better than return an empty vector
-		return resultPath;
-	}
-
-// 2. Allocate memory and reset variables
-
-	whichList = new int* [mine->GetHeight() + 1];
-	for (int i = 0; i < mine->GetHeight(); i++) {
-		whichList[i] = new int [mine->GetWidth() + 1];
-		for (int j = 0; j < mine->GetWidth(); j++)
-			whichList[i][j] = 0;
-	}
-
-	parent = new IntPair* [mine->GetHeight() + 1];
-	for (int i = 0; i < mine->GetHeight(); i++) {
-		parent[i] = new IntPair [mine->GetWidth() + 1];
-	}
-
-	openList = new OpenListItem [mine->GetWidth()*mine->GetHeight()+2];
-
-	resultPath.clear();
-
-// 3. Add the starting cell to the open list.
-
-	numberOfOpenListItems = 1;
-	openList[1].SetX(startX);	// assign it as the top item in the binary heap
-	openList[1].SetY(startY);
-	openList[1].SetGcost(0);	// reset starting cell's G value to 0
-
-// 4. Do it until the path is found or recognized as nonexistent.
-
-	while (true) {
-	
-// 4.1. If the open list is not empty, take the first cell off of the list (i.e. the lowest F cost cell).
-
-		if (numberOfOpenListItems != 0) {
-			// record cell coordinates and Gcost of the item as parent for adjacent cells (see below)
-			parentX = openList[1].GetX();
-			parentY = openList[1].GetY();
-			Gcost = openList[1].GetGcost();
-
-			whichList[parentX][parentY] = inClosedList;	// add item to the closed list
-			DeleteTopItemFromBinaryHeap(openList, numberOfOpenListItems);				// delete this item from the open list
-
-// 4.2. Check the adjacent squares and add them to the open list
-
-			for (int x = parentX - 1; x <= parentX + 1; x++) {
-				for (int y = parentY - 1; y <= parentY + 1; y++) {
-					if ((x != parentX && y != parentY) || (x == parentX && y == parentY))
-						continue;
-
-					// If not off the map (avoiding array-out-of-bounds errors)
-					if (x != -1 && y != -1 && x != mine->GetHeight() && y != mine->GetWidth()) {
-						
-						// If not already on the closed list (items on the closed list have already been considered and can now be ignored).
-						if (whichList[x][y] != inClosedList) {
-							// If not a wall/obstacle square.
-							if (mine->GetMap()[x][y] != '#' && mine->GetMap()[x][y] != '*') {																// TBD: use isWalkable(...) method from Field class
-								// If cell is not already on the open list, add it to the open list.
-								if (whichList[x][y] != inOpenList) {
-									numberOfOpenListItems++;					// increment number of items in the heap
-									openList[numberOfOpenListItems].SetX(x);	// record the x and y coordinates of the new item
-									openList[numberOfOpenListItems].SetY(y);
-
-									// Figure out its G cost
-									openList[numberOfOpenListItems].SetGcost(Gcost + 1);
-									
-									// Figure out its H and F costs and parent
-									parent[x][y].first = parentX;							// change the cell's parent
-									parent[x][y].second = parentY;
-									// F cost includes H cost except when we want to use A* algorithm as Dijkstra's algorithm
-									if (useHcost) openList[numberOfOpenListItems].SetHcost( (abs(x - targetX) + abs(y - targetY)) );
-									openList[numberOfOpenListItems].CalculateFcost();	// update the F cost
-									
-									// Move the new open list item to the proper place in the binary heap.
-									BubbleItemInBinaryHeap(openList, numberOfOpenListItems);
-
-									whichList[x][y] = inOpenList;	// Change whichList value.
-								}
-								// If cell is already on the open list, choose better G and F costs.
-								else {
-									index = GetItemIndexFromBinaryHeapByCoord(openList, numberOfOpenListItems, x, y);
-									Gcost += 1;	// Figure out the G cost of this possible new path
-
-									// If this path is shorter (G cost is lower) then change the parent cell, G cost and F cost. 		
-									if (Gcost < openList[index].GetGcost()) {
-										parent[x][y].first = parentX;			// change the cell's parent
-										parent[x][y].second = parentY;
-										openList[index].SetGcost(Gcost);	// change the G cost
-										openList[index].CalculateFcost();	// update the F cost
-										BubbleItemInBinaryHeap(openList, index);		// update cell's position on the open list
-									}
-								}	
-							}
-						}
-					}
-				}
-			}
-		} else {
-
-// 4.3. If open list is empty then there is no path.	
-		
-			path = nonexistent;
-			break;
-		}  
-
-// 5. If target cell is added to open list then path has been found.
-
-		if (whichList[targetX][targetY] == inOpenList) {
-			path = found;
-			break;
-		}
-	}	// end while
-
-// 6. Save the path if it exists.
-
-	if (path == found) {
-
-// 6.1. Working backwards from the target to the start by checking each cell's parent.
-
-		int x = targetX, y = targetY;
-		int tmp;
-		while (true) {
-			// Save path in reverse order
-			resultPath.push_back(IntPair (x, y));
-
-			if (x == startX && y == startY) break;
-
-			// Look up the parent of the current cell
-			tmp = parent[x][y].first;
-			y = parent[x][y].second;
-			x = tmp;
-		} 
-
-// 6.2. Reversing path
-
-		int size = (int) resultPath.size();
-		int amount = size/2;
-		IntPair tmpIntPair;
-		for (int i = 0; i < amount; i++) {
-			tmpIntPair = resultPath[size - i - 1];
-			resultPath[size - i - 1] = resultPath[i];
-			resultPath[i] = tmpIntPair;
+	IntPair start(startX, startY), target(targetX, targetY);
+
+	PrepareJumps();
+	if (jumps.FindPath(start, target, false, &resultPath) == -1) {
+		PrepareWalls();
+		if (wallJumps.FindPath(start, target, false, &resultPath) == -1) {
+			resultPath.assign(1, IntPair (-1, -1));	// its better than return an empty vector
+			return resultPath;
 		}
-		
-	} else resultPath.push_back(IntPair (-1, -1));	// its better than return an empty vector
-
-// 7. Freeing used memory
-
-	for (int i = 0; i < mine->GetHeight(); i++)
-		delete [] whichList[i];
-	for (int i = 0; i < mine->GetHeight(); i++)
-		delete [] parent[i];
-	delete [] openList;
+	}
 
+	resultPath.insert(resultPath.begin(), IntPair (startX, startY));
 	return resultPath;
 }
 
 
-// Description: Deletes the top item in binary heap and reorder the heap, with the lowest F cost item rising to the top.
-void TSPSolver::DeleteTopItemFromBinaryHeap(OpenListItem * heap, int & heapLength)
-{
-	heapLength--;								// decrease number of items in heap
-	heap[1] = heap[heapLength + 1];				// move last item up to slot #1
-	SinkItemInBinaryHeap(heap, heapLength, 1);	// move item to the properly position
-	
-}
-
-// Description: Finds the item in the binary heap by cell's coordinates and returns its index.
-int TSPSolver::GetItemIndexFromBinaryHeapByCoord(OpenListItem * heap, int heapLength, const int & x, const int & y)
-{
-	int index = -1;
-	for (int i = 1; i <= heapLength; i++) {
-		if (heap[i].GetX() == x && heap[i].GetY() == y) {
-			index = i;
-			break;
-		}
-	}
-	return index;
-}
-
-// Description: Bubbles target item to the properly position in binary heap
-void TSPSolver::BubbleItemInBinaryHeap(OpenListItem * heap, int index)
+// Description: Prepares the search around walls and rocks when it is needed first
+void TSPSolver::PrepareJumps()
 {
-	while (index != 1) {	// While item hasn't bubbled to the top
-		// Swap items if child < parent.
-		if (heap[index].GetFcost() <= heap[index/2].GetFcost()) {
-			OpenListItem temp = heap[index/2];
-			heap[index/2] = heap[index];
-			heap[index] = temp;
-			index = index/2;
-		} else break;
-	}
+	if (jumpsPrepared) return;
+	jumps.Prepare(*mine);
+	jumpsPrepared = true;
 }
 
-// Description: Sinks target item to the properly position in binary heap
-void TSPSolver::SinkItemInBinaryHeap(OpenListItem * heap, int heapLength, int index)
+// Description: Prepares the search around walls alone when it is needed first
+void TSPSolver::PrepareWalls()
 {
-	int curr, next = 1;
-
-	// Repeat the following until the new item in slot #1 sinks to its proper spot in the heap.
-	while (true) {
-		curr = next;		
-		if (2*curr + 1 <= heapLength) {	// if both children exist
-			// Check if the F cost of the parent is greater than each child and select the lowest one.
-			if (heap[curr].GetFcost() >= heap[2*curr].GetFcost()) 
-				next = 2*curr;
-			if (heap[next].GetFcost() >= heap[2*curr + 1].GetFcost())
-				next = 2*curr+1;		
-		} else {
-			if (2*curr <= heapLength) {	// if only child #1 exists
-				// Check if the F cost of the parent is greater than child #1	
-				if (heap[curr].GetFcost() >= heap[2*curr].GetFcost()) 
-					next = 2*curr;
-			}
-		}
-
-		if (curr != next) {	// if parent's F > one of its children, swap them
-			OpenListItem temp = heap[curr];
-			heap[curr] = heap[next];
-			heap[next] = temp;
-		} else break;		// otherwise, exit loop
-	}
+	if (wallsPrepared) return;
+	wallJumps.Prepare(*mine, true);
+	wallsPrepared = true;
 }
 
 // Description: Builds result path as sequence of cells's coordinates
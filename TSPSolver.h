@@ -2,6 +2,7 @@
 
 #include "stdafx.h"
 #include "Field.h"
+#include "JumpSearch.h"
 #include <map>
 #include <set>
 
@@ -15,19 +16,29 @@ class TSPSolver
 	vector<IntPair> nodes;
 	vector<int> tour;
 	int tourDistance;
+	vector< vector<IntPair> > candidates;	// orders of the nodes worth simulating
+
+	JumpSearch jumps;				// ways around walls and rocks as they are now
+	bool jumpsPrepared;				// jumps is prepared, it is done when walked distances are needed first
+	JumpSearch wallJumps;			// ways around walls alone to the nodes rocks shut off, rocks fall or are pushed away
+	bool wallsPrepared;				// wallJumps is prepared, it is done when a way around rocks is missing first
+	vector<int> walkDistances;		// walked distances between the nodes, -1 until needed; empty if there are too many nodes
+	bool walking;					// GetDistance returns walked distances instead of Manhattan ones
 public:
 	TSPSolver(Field * amine);
 	~TSPSolver(void);
 	
-	vector<IntPair> GetTourPath();
+	const vector<IntPair> & GetTourPath();
 	vector<IntPair> GetPath(const int & start, const int & target);
-	vector<IntPair> GetNodes();
-	vector<int> GetTour();
+	const vector<IntPair> & GetNodes();
+	const vector< vector<IntPair> > & GetCandidates();
+	const vector<int> & GetTour();
 	int GetTourDistance();
 
-	void Solve(const int & iterations);
+	void Solve(const int & iterations, size_t candidatesNum = 1);
 
 private:
+	void FindCandidates(const int & iterations, size_t candidatesNum);
 	void SetMatrixes();
 	int GetDistance(const int & node1, const int & node2);
 	void SetTourDistance(int dist);
@@ -35,18 +46,17 @@ private:
 
 	void CreateNearestNeighbourTour();
 	int GetNearestNeighbour(const int & node, set<int> & nodeSet);
+	void CreateRandomNeighbourTour(vector<int> & order, unsigned & seed);
+	void PerturbTour(vector<int> & order, int reversals, unsigned & seed);
+	void AddCandidate(const vector<int> & order);
 
 	void StartTwoOpt();
 	void TwoOpt(const int & startN1Index, const int & targetN1Index,
 				const int & startN2Index, const int & targetN2Index);
 
-	vector<IntPair> FindPath(int startX, int startY,
-									int targetX, int targetY,
-									bool useHcost = true);	// Finds a path using A*.			// TBD: using useHcost = false (i.e. Dijkstra instead of Astar) is useless?
-	void DeleteTopItemFromBinaryHeap(OpenListItem * heap, int & heapLength);
-	int GetItemIndexFromBinaryHeapByCoord(OpenListItem * heap, int heapLength, const int & x, const int & y);
-	void BubbleItemInBinaryHeap(OpenListItem * heap, int index);
-	void SinkItemInBinaryHeap(OpenListItem * heap, int heapLength, int index);
+	vector<IntPair> FindPath(int startX, int startY, int targetX, int targetY);	// finds a path by jump search
+	void PrepareJumps();
+	void PrepareWalls();
 
 	void SetTourPath();
 };
@@ -0,0 +1,100 @@
+#include "TourEvaluator.h"
+#include "Simulator.h"
+#include "Deadline.h"
+#include <unistd.h>
+
+
+TourEvaluator::TourEvaluator(Field & amine)
+{
+	this->mine = amine;
+	threadsNum = TOUR_THREADS;
+	snapshotBudget = SEARCH_SNAPSHOT_BUDGET;
+	walkDistance = SAFE_WALK_MIN_DISTANCE;
+	expanded = 0;
+	tours = NULL;
+	next = 0;
+	threadBudget = snapshotBudget;
+}
+
+TourEvaluator::~TourEvaluator(void)
+{
+}
+
+void TourEvaluator::SetThreads(int threads)
+{
+	threadsNum = threads;
+}
+
+void TourEvaluator::SetSnapshotBudget(size_t bytes)
+{
+	snapshotBudget = bytes;
+}
+
+void TourEvaluator::SetSafeWalk(int distance)
+{
+	walkDistance = distance;
+}
+
+const vector< vector<IntPair> > & TourEvaluator::GetPaths()
+{
+	return this->paths;
+}
+
+size_t TourEvaluator::GetExpandedNodes()
+{
+	return this->expanded;
+}
+
+// Description: Simulates every tour and then the first tours with the safe walk; the paths keep
+// the order of the simulations
+void TourEvaluator::Evaluate(const vector< vector<IntPair> > & atours)
+{
+	size_t walked = walkDistance > 0 ? min((size_t) SAFE_WALK_TOURS, atours.size()) : 0;
+	int threads = threadsNum;
+	if (threads <= 0) threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads <= 0) threads = 1;
+	threads = max(1, min(threads, (int) (atours.size() + walked)));
+
+	tours = &atours;
+	paths.assign(atours.size() + walked, vector<IntPair>());
+	next = 0;
+	threadBudget = snapshotBudget / threads;
+
+	vector<Worker> workers(threads);
+	vector<pthread_t> handles(threads);
+	for (int i = 0; i < threads; i++) {
+		workers[i].evaluator = this;
+		workers[i].expanded = 0;
+	}
+	for (int i = 1; i < threads; i++)
+		pthread_create(&handles[i], NULL, Simulate, &workers[i]);
+	SimulateTours(workers[0]);
+	for (int i = 1; i < threads; i++)
+		pthread_join(handles[i], NULL);
+
+	for (int i = 0; i < threads; i++)
+		expanded += workers[i].expanded;
+	tours = NULL;
+}
+
+void * TourEvaluator::Simulate(void * worker)
+{
+	Worker * simulator = (Worker *) worker;
+	simulator->evaluator->SimulateTours(*simulator);
+	return NULL;
+}
+
+// Description: Takes simulations until none is left; every simulation writes only its own path
+void TourEvaluator::SimulateTours(Worker & worker)
+{
+	for (size_t i = __sync_fetch_and_add(&next, 1); i < paths.size() && !Deadline::Expired();
+		i = __sync_fetch_and_add(&next, 1)) {
+		bool walked = i >= tours->size();
+		Simulator sim(mine);
+		sim.SetSnapshotBudget(threadBudget);
+		sim.SetSafeWalk(walked ? walkDistance : 0);
+		sim.StartSimulation((*tours)[walked ? i - tours->size() : i]);
+		worker.expanded += sim.GetExpandedNodes();
+		paths[i] = sim.GetPath();
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "stdafx.h"
+#include "Field.h"
+#include <pthread.h>
+
+// Simulator of several orders of the waypoints at once.
+// Threads take the next tour from a shared counter and run their own Simulator on it, so tours
+// simulated longer don't keep the other threads waiting. The snapshot budget is shared by the threads.
+// With the safe walk on, the first SAFE_WALK_TOURS tours are simulated once more with it: the walked
+// way changes the rock falls later in the tour, which is better on some maps and worse on others.
+class TourEvaluator
+{
+	// Thread simulating tours and the cells it has expanded
+	struct Worker
+	{
+		TourEvaluator * evaluator;
+		size_t expanded;
+	};
+
+	Field mine;
+	int threadsNum;
+	size_t snapshotBudget;		// memory of the snapshots of all threads
+	int walkDistance;			// see Simulator::SetSafeWalk
+	size_t expanded;
+
+	const vector< vector<IntPair> > * tours;
+	vector< vector<IntPair> > paths;
+	size_t next;				// index of the simulation taken by the next thread, walked ones follow the tours
+	size_t threadBudget;		// memory of the snapshots of one thread
+
+public:
+	TourEvaluator(Field & amine);
+	~TourEvaluator(void);
+
+	void SetThreads(int threads);	// 0 uses all processors
+	void SetSnapshotBudget(size_t bytes);
+	void SetSafeWalk(int distance);
+	void Evaluate(const vector< vector<IntPair> > & atours);
+
+	const vector< vector<IntPair> > & GetPaths();	// cells of the robot for every tour and then for the walked ones, empty if the budget ended first
+	size_t GetExpandedNodes();
+
+private:
+	static void * Simulate(void * worker);
+	void SimulateTours(Worker & worker);
+};
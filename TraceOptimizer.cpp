@@ -0,0 +1,287 @@
+#include "TraceOptimizer.h"
+#include "Deadline.h"
+#include <algorithm>
+#include <unistd.h>
+
+
+TraceOptimizer::TraceOptimizer(const Game & agame)
+	: start(agame)
+{
+	threadsNum = TRACE_THREADS;
+	rounds = TRACE_ROUNDS;
+	score = start.GetScore();
+	next = 0;
+}
+
+TraceOptimizer::~TraceOptimizer(void)
+{
+}
+
+void TraceOptimizer::SetThreads(int threads)
+{
+	threadsNum = threads;
+}
+
+const vector<_Command> & TraceOptimizer::GetTrace()
+{
+	return this->trace;
+}
+
+int TraceOptimizer::GetScore()
+{
+	return this->score;
+}
+
+// Description: Shortens the trace round after round until a round finds nothing, the rounds end
+// or the Deadline expires
+void TraceOptimizer::Optimize(const vector<_Command> & atrace)
+{
+	trace = atrace;
+	Replay();
+
+	for (size_t round = 0; round < rounds && !Deadline::Expired(); round++) {
+		OptimizeWindows();
+		if (!Apply()) break;
+	}
+}
+
+// Description: Plays the trace from the start, cuts it where the game ends and saves the checkpoints
+// and the robot, the mine and the score before every command
+void TraceOptimizer::Replay()
+{
+	Game game = start;
+	checkpoints.clear();
+	cells.clear();
+	hashes.clear();
+	scores.clear();
+
+	size_t i = 0;
+	for (; i < trace.size() && game.GetResult() == 0; i++) {
+		if (i % TRACE_WINDOW == 0) checkpoints.push_back(game);
+		cells.push_back(game.GetField()->GetRobot());
+		hashes.push_back(game.GetField()->GetHash());
+		scores.push_back(game.GetScore());
+		game.MoveRobot(trace[i]);
+	}
+	trace.resize(i);
+	cells.push_back(game.GetField()->GetRobot());
+	hashes.push_back(game.GetField()->GetHash());
+	scores.push_back(game.GetScore());
+	score = game.GetScore();
+}
+
+// Description: Plays the commands until the game ends
+// Returns: score of the game
+int TraceOptimizer::Play(Game & game, const vector<_Command> & commands)
+{
+	for (size_t i = 0; i < commands.size() && game.GetResult() == 0; i++) {
+		game.MoveRobot(commands[i]);
+	}
+	return game.GetScore();
+}
+
+// Description: Finds the edits of every window; the edits keep the order of the windows
+void TraceOptimizer::OptimizeWindows()
+{
+	int threads = threadsNum;
+	if (threads <= 0) threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads <= 0) threads = 1;
+	threads = max(1, min(threads, (int) checkpoints.size()));
+
+	edits.assign(checkpoints.size(), vector<Edit>());
+	next = 0;
+
+	vector<Worker> workers(threads);
+	vector<pthread_t> handles(threads);
+	for (int i = 0; i < threads; i++)
+		workers[i].optimizer = this;
+	for (int i = 1; i < threads; i++)
+		pthread_create(&handles[i], NULL, Run, &workers[i]);
+	Run(&workers[0]);
+	for (int i = 1; i < threads; i++)
+		pthread_join(handles[i], NULL);
+}
+
+// Description: Takes windows until none is left; every window writes only its own edits
+void * TraceOptimizer::Run(void * worker)
+{
+	TraceOptimizer * optimizer = ((Worker *) worker)->optimizer;
+	for (size_t i = __sync_fetch_and_add(&optimizer->next, 1); i < optimizer->checkpoints.size() && !Deadline::Expired();
+		i = __sync_fetch_and_add(&optimizer->next, 1)) {
+		optimizer->OptimizeWindow(i);
+	}
+	return NULL;
+}
+
+// Description: Walks the window from its checkpoint. At every command the cells the robot reaches
+// later are looked up among the ways found from its cell; at most TRACE_EDIT_TRIES shorter ways are
+// verified from the one saving the most commands, and the first one raising the score becomes an edit. The walk goes on
+// after the replaced commands, so the edits of a window never overlap.
+void TraceOptimizer::OptimizeWindow(size_t window)
+{
+	size_t i = window * TRACE_WINDOW;
+	size_t end = min(i + TRACE_WINDOW, trace.size());
+	Game game = checkpoints[window];
+	vector<Step> steps;
+	vector< pair<int, size_t> > shortcuts;		// commands the way is longer than the trace, and its end
+	// The abort ending the trace is never replaced, so the game still ends where the planner ended it
+	size_t moves = trace.size();
+	if (moves > 0 && trace[moves - 1] == ABORT) moves--;
+
+	while (i < end && !Deadline::Expired()) {
+		size_t last = min(i + TRACE_SHORTCUT_LENGTH, moves);
+		FindWays(game, steps);
+
+		shortcuts.clear();
+		for (size_t j = i + 1; j <= last; j++) {
+			int x = cells[j].first - cells[i].first + TRACE_SHORTCUT_LENGTH;
+			int y = cells[j].second - cells[i].second + TRACE_SHORTCUT_LENGTH;
+			int distance = steps[x * (2 * TRACE_SHORTCUT_LENGTH + 1) + y].distance;
+			if (distance >= 0 && distance < (int) (j - i))
+				shortcuts.push_back(make_pair(distance - (int) (j - i), j));
+		}
+		sort(shortcuts.begin(), shortcuts.end());
+
+		size_t replaced = i + 1;
+		for (size_t k = 0; k < shortcuts.size() && k < TRACE_EDIT_TRIES && !Deadline::Expired(); k++) {
+			Edit edit;
+			edit.begin = i;
+			edit.end = shortcuts[k].second;
+			BuildWay(steps, cells[i], cells[edit.end], edit.commands);
+			edit.score = Verify(game, edit.end, edit.commands);
+			if (edit.score > score) {
+				edits[window].push_back(edit);
+				replaced = edit.end;
+				break;
+			}
+		}
+
+		for (; i < replaced; i++)
+			game.MoveRobot(trace[i]);
+	}
+}
+
+// Description: Plays the commands instead of the trace up to the end and then the rest of the trace,
+// until the mine is the same as in the original game at the same command
+// Returns: score of the game with the commands
+int TraceOptimizer::Verify(const Game & game, size_t end, const vector<_Command> & commands)
+{
+	Game edited = game;
+	Play(edited, commands);
+	if (edited.GetResult() != 0)
+		return edited.GetScore();
+
+	for (size_t k = end; k < trace.size(); k++) {
+		// The rest of the game is the same, only the score differs
+		if (edited.GetField()->GetHash() == hashes[k])
+			return edited.GetScore() + score - scores[k];
+		edited.MoveRobot(trace[k]);
+		if (edited.GetResult() != 0) break;
+	}
+	return edited.GetScore();
+}
+
+// Description: Finds the shortest ways of the robot at most TRACE_SHORTCUT_LENGTH moves long through
+// the cells it can enter without pushing rocks, as the mine is now. The steps are a square around
+// the robot with the length of the way to every cell, -1 if it isn't reached, and its last move.
+void TraceOptimizer::FindWays(Game & game, vector<Step> & steps)
+{
+	const int length = TRACE_SHORTCUT_LENGTH;
+	const int side = 2 * length + 1;
+	const int dx[] = { -1, 1, 0, 0 };
+	const int dy[] = { 0, 0, -1, 1 };
+	const _Command moves[] = { UP, DOWN, LEFT, RIGHT };
+
+	Field * mine = game.GetField();
+	IntPair robot = mine->GetRobot();
+	Step unreached;
+	unreached.distance = -1;
+	unreached.command = WAIT;
+	steps.assign(side * side, unreached);
+
+	vector<IntPair> queue;
+	queue.push_back(IntPair(length, length));
+	steps[length * side + length].distance = 0;
+	for (size_t head = 0; head < queue.size(); head++) {
+		int x = queue[head].first, y = queue[head].second;
+		const Step & step = steps[x * side + y];
+		if (step.distance == length) continue;
+		// The game ends in the lift, so no way goes on from it
+		if (step.distance > 0 && mine->GetObject(robot.first + x - length, robot.second + y - length) == OPENED_LIFT)
+			continue;
+
+		for (int d = 0; d < 4; d++) {
+			int nx = x + dx[d], ny = y + dy[d];
+			if (nx < 0 || nx >= side || ny < 0 || ny >= side || steps[nx * side + ny].distance >= 0)
+				continue;
+			int row = robot.first + nx - length, column = robot.second + ny - length;
+			if (row < 0 || row >= mine->GetHeight() || column < 0 || column >= mine->GetWidth())
+				continue;
+			_MineObject object = mine->GetObject(row, column);
+			if (object != EMPTY && object != EARTH && object != LAMBDA && object != OPENED_LIFT)
+				continue;
+			steps[nx * side + ny].distance = step.distance + 1;
+			steps[nx * side + ny].command = moves[d];
+			queue.push_back(IntPair(nx, ny));
+		}
+	}
+}
+
+// Description: Builds the commands of the way found by FindWays from the cell of the robot to the cell
+void TraceOptimizer::BuildWay(const vector<Step> & steps, IntPair from, IntPair to, vector<_Command> & commands)
+{
+	const int side = 2 * TRACE_SHORTCUT_LENGTH + 1;
+	int x = to.first - from.first + TRACE_SHORTCUT_LENGTH;
+	int y = to.second - from.second + TRACE_SHORTCUT_LENGTH;
+
+	commands.clear();
+	for (int distance = steps[x * side + y].distance; distance > 0; distance--) {
+		_Command command = steps[x * side + y].command;
+		commands.push_back(command);
+		if (command == UP) x++;
+		else if (command == DOWN) x--;
+		else if (command == LEFT) y++;
+		else y--;
+	}
+	reverse(commands.begin(), commands.end());
+}
+
+// Description: Applies the edits in the order of the trace, each one only if the whole trace with it
+// and the edits applied before it scores more, and replays the new trace
+// Returns: true if any edit is applied
+bool TraceOptimizer::Apply()
+{
+	vector<_Command> current = trace;
+	int currentScore = score;
+	size_t removed = 0;		// commands removed from the trace by the applied edits
+	size_t done = 0;		// end of the last applied edit in the trace
+	bool applied = false;
+
+	for (size_t w = 0; w < edits.size() && !Deadline::Expired(); w++) {
+		for (size_t i = 0; i < edits[w].size(); i++) {
+			const Edit & edit = edits[w][i];
+			// An edit reaching into the next window may overlap the first edits of that window
+			if (edit.begin < done) continue;
+
+			vector<_Command> candidate(current.begin(), current.begin() + (edit.begin - removed));
+			candidate.insert(candidate.end(), edit.commands.begin(), edit.commands.end());
+			candidate.insert(candidate.end(), current.begin() + (edit.end - removed), current.end());
+
+			Game game = start;
+			int candidateScore = Play(game, candidate);
+			if (candidateScore > currentScore) {
+				current.swap(candidate);
+				currentScore = candidateScore;
+				removed += edit.end - edit.begin - edit.commands.size();
+				done = edit.end;
+				applied = true;
+			}
+		}
+	}
+
+	if (applied) {
+		trace.swap(current);
+		Replay();
+	}
+	return applied;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "stdafx.h"
+#include "Game.h"
+#include <pthread.h>
+
+// Shortener of a finished trace that never lowers its score.
+// The trace is cut into windows of TRACE_WINDOW commands and the game before every window is
+// kept as a checkpoint. Threads take the next window from a shared counter, replay it from its
+// checkpoint and try to replace pieces of it by shorter ways between the same cells of the robot:
+// removed loops, waits and moves into walls, shortcuts around detours. Every edit is verified by
+// replaying the rest of the trace until the mine is the same as in the original game or the game
+// ends. The verified edits of all windows are then applied one by one, each only if the whole
+// trace still scores more with it, and the rounds go on while they find something.
+class TraceOptimizer
+{
+	// Commands replacing the commands [begin, end) of the trace and the score they give
+	struct Edit
+	{
+		size_t begin;
+		size_t end;
+		vector<_Command> commands;
+		int score;
+	};
+
+	// Way to a cell found by the search of shortcuts: its length and the last move
+	struct Step
+	{
+		int distance;
+		_Command command;
+	};
+
+	// Thread optimizing windows
+	struct Worker
+	{
+		TraceOptimizer * optimizer;
+	};
+
+	Game start;
+	int threadsNum;
+	size_t rounds;
+
+	vector<_Command> trace;
+	int score;
+	vector<Game> checkpoints;		// the game before every window of the trace
+	vector<IntPair> cells;			// the robot before every command and after the last one
+	vector<_StateHash> hashes;		// the mine before every command and after the last one
+	vector<int> scores;				// the score before every command and after the last one
+	vector< vector<Edit> > edits;	// verified edits of every window
+	size_t next;					// index of the window taken by the next thread
+
+public:
+	TraceOptimizer(const Game & agame);
+	~TraceOptimizer(void);
+
+	void SetThreads(int threads);	// 0 uses all processors
+	void Optimize(const vector<_Command> & atrace);
+
+	const vector<_Command> & GetTrace();	// the trace cut at the end of the game
+	int GetScore();
+
+private:
+	void Replay();
+	static int Play(Game & game, const vector<_Command> & commands);
+	static void * Run(void * worker);
+	void OptimizeWindows();
+	void OptimizeWindow(size_t window);
+	int Verify(const Game & game, size_t end, const vector<_Command> & commands);
+	void FindWays(Game & game, vector<Step> & steps);
+	void BuildWay(const vector<Step> & steps, IntPair from, IntPair to, vector<_Command> & commands);
+	bool Apply();
+};
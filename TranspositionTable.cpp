@@ -0,0 +1,74 @@
+#include "TranspositionTable.h"
+
+
+TranspositionTable::TranspositionTable(void)
+{
+	size = 0;
+}
+
+void TranspositionTable::Clear()
+{
+	if (size == 0) return;
+	for (size_t i = 0; i < entries.size(); i++)
+		entries[i].hash = 0;
+	size = 0;
+}
+
+bool TranspositionTable::Update(_StateHash hash, int cost, int node)
+{
+	if (hash == 0) hash = 1;		// 0 marks free entries
+	if ((size + 1) * 2 > entries.size()) Grow();
+
+	Entry & entry = entries[Slot(hash)];
+	if (entry.hash == hash && entry.cost <= cost) return false;
+
+	if (entry.hash != hash) {
+		entry.hash = hash;
+		size++;
+	}
+	entry.cost = cost;
+	entry.node = node;
+	return true;
+}
+
+int TranspositionTable::Find(_StateHash hash)
+{
+	if (hash == 0) hash = 1;
+	if (entries.empty()) return -1;
+	Entry & entry = entries[Slot(hash)];
+	return entry.hash == hash ? entry.node : -1;
+}
+
+int TranspositionTable::GetCost(_StateHash hash)
+{
+	if (hash == 0) hash = 1;
+	if (entries.empty()) return -1;
+	Entry & entry = entries[Slot(hash)];
+	return entry.hash == hash ? entry.cost : -1;
+}
+
+// Description: Looks for the state from the entry of its hash on, the table is never full
+size_t TranspositionTable::Slot(_StateHash hash)
+{
+	size_t mask = entries.size() - 1;
+	size_t slot = (size_t) (hash ^ (hash >> 32)) & mask;
+	while (entries[slot].hash != 0 && entries[slot].hash != hash)
+		slot = (slot + 1) & mask;
+	return slot;
+}
+
+void TranspositionTable::Grow()
+{
+	vector<Entry> old;
+	old.swap(entries);
+
+	Entry empty;
+	empty.hash = 0;
+	empty.cost = 0;
+	empty.node = -1;
+	entries.assign(old.empty() ? 1024 : old.size() * 2, empty);
+
+	for (size_t i = 0; i < old.size(); i++) {
+		if (old[i].hash != 0) entries[Slot(old[i].hash)] = old[i];
+	}
+}
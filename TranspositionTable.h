@@ -0,0 +1,36 @@
+#pragma once
+
+#include "stdafx.h"
+
+// Table of the game states met by a search, keyed by the hash of the state (see Field::GetHash).
+// Every state keeps the lowest cost it was reached with and the node of the search reaching it,
+// so a state reached again at no lower cost is recognised as a duplicate and dropped.
+// States are kept in an open-addressed array which grows twice when it is half full;
+// different states with the same 64-bit hash are not told apart.
+class TranspositionTable
+{
+	struct Entry
+	{
+		_StateHash hash;	// hash of the state, 0 for free entries
+		int cost;
+		int node;
+	};
+
+	vector<Entry> entries;
+	size_t size;
+
+public:
+	TranspositionTable(void);
+
+	void Clear();					// forgets all states, the memory is kept
+	size_t Size() { return size; }
+
+	// Returns true if the state is new or is reached at lower cost, the cost and the node are kept then
+	bool Update(_StateHash hash, int cost, int node);
+	int Find(_StateHash hash);		// returns node of the state or -1
+	int GetCost(_StateHash hash);	// returns cost of the state or -1
+
+private:
+	size_t Slot(_StateHash hash);	// returns entry of the state or the free entry where it would be put
+	void Grow();
+};
@@ -11,15 +11,22 @@
 #include <vector>
 #include <string>
 #include <math.h>
+#include <string.h>
 #include <algorithm>
 
 using namespace std;
 
+// Move constructors and assignments are compiled when the compiler supports C++11
+#if __cplusplus >= 201103L
+#define HAS_MOVE_SEMANTICS
+#endif
+
 typedef pair<int, int> IntPair;
 
 typedef char _MineObject;
 typedef char _Command;
 typedef int _GameResult;
+typedef unsigned long long _StateHash;
 
 #define DEATH_ESCAPE 1
 #define ABORT_ESCAPE 2
@@ -41,6 +48,117 @@ typedef int _GameResult;
 #define WAIT 'W'
 #define ABORT 'A'
 
+// Field backends: char grid with incremental rock updates or bit planes with word-parallel updates
+#define GRID_BACKEND 0
+#define BITBOARD_BACKEND 1
+
+// Field storages: one char per cell or two 4-bit cell codes per byte
+#define BYTE_STORAGE 0
+#define PACKED_STORAGE 1
+// Storage of the loaded maps, Field::SetStorage changes it at run time
+#ifndef FIELD_DEFAULT_STORAGE
+#define FIELD_DEFAULT_STORAGE BYTE_STORAGE
+#endif
+
+// Rows of the Field buffer are padded to a multiple of this value
+#define FIELD_STRIDE_ALIGN 16
+// Field copies share bands of this many rows until one of them writes into the band
+#define FIELD_TILE_ROWS 8
+// Size of the blocks in which Field::LoadMap reads streams
+#define FIELD_READ_BLOCK 65536
+
+// Estimated memory of the field snapshots one robot search may hold, older ones are replayed when needed
+#ifndef SEARCH_SNAPSHOT_BUDGET
+#define SEARCH_SNAPSHOT_BUDGET ((size_t) 256 << 20)
+#endif
+
+// Planners of the robot's way: A* over robot cells with field snapshots, A* over whole game states,
+// beam search or Monte Carlo tree search over whole games
+#define CELL_PLANNER 0
+#define STATE_PLANNER 1
+#define BEAM_PLANNER 2
+#define MCTS_PLANNER 3
+// Nodes StatePlanner may expand while looking for the way to one waypoint
+#ifndef PLANNER_NODE_LIMIT
+#define PLANNER_NODE_LIMIT 200000
+#endif
+// States BeamSolver keeps on every level and threads expanding them, 0 threads use all processors
+#ifndef BEAM_WIDTH
+#define BEAM_WIDTH 100
+#endif
+#ifndef BEAM_THREADS
+#define BEAM_THREADS 0
+#endif
+// Rollouts every MctsSolver thread makes before a command and threads making them, 0 threads use all processors
+#ifndef MCTS_ITERATIONS
+#define MCTS_ITERATIONS 200
+#endif
+#ifndef MCTS_THREADS
+#define MCTS_THREADS 0
+#endif
+// Commands of one rollout and the percentage of them heading for the nearest lambda
+#define MCTS_ROLLOUT_DEPTH 40
+#define MCTS_GREEDY_PERCENT 70
+// Weight of the exploration term of UCT
+#define MCTS_EXPLORATION 0.7
+// Commands played without finding a better game before MctsSolver gives up
+#define MCTS_STALL_MOVES 100
+
+// Orders of the lambdas the cell planner simulates and threads simulating them, 0 threads use all processors
+#ifndef TOUR_CANDIDATES
+#define TOUR_CANDIDATES 16
+#endif
+#ifndef TOUR_THREADS
+#define TOUR_THREADS 0
+#endif
+// Largest number of tour nodes for which a 2-opt pass is one of the candidates
+#define TOUR_TWO_OPT_NODES 150
+// Nearest nodes a randomized nearest neighbour tour chooses from
+#define TOUR_NEIGHBOUR_CHOICES 3
+// Tours by distances walked around walls and rocks added to the candidates made by Manhattan distances,
+// if there are at most TOUR_WALK_NODES nodes: the distances take a table of all pairs and a search from every node
+#ifndef TOUR_WALK_CANDIDATES
+#define TOUR_WALK_CANDIDATES 8
+#endif
+#ifndef TOUR_WALK_NODES
+#define TOUR_WALK_NODES 150
+#endif
+
+// Simulator walks the safe runs of the shortest way to a lambda at least this far without the search
+// and searches only the pieces of the way near rocks; 0 turns it off, -a sets it. The walked way
+// may differ from the searched one, which changes the rock falls later in the tour, so the first
+// SAFE_WALK_TOURS tours are simulated both with the walk and without it.
+#ifndef SAFE_WALK_MIN_DISTANCE
+#define SAFE_WALK_MIN_DISTANCE 8
+#endif
+#ifndef SAFE_WALK_TOURS
+#define SAFE_WALK_TOURS 16
+#endif
+
+// Rounds of shortening the found trace, 0 turns it off, and threads doing it, 0 threads use all processors.
+// The trace is optimized in windows of TRACE_WINDOW commands; a piece of it at most TRACE_SHORTCUT_LENGTH
+// commands long may be replaced by a shorter way. An edit which changes the mine for good is verified
+// by replaying the whole rest of the trace, so only TRACE_EDIT_TRIES edits are tried at every command.
+#ifndef TRACE_ROUNDS
+#define TRACE_ROUNDS 8
+#endif
+#ifndef TRACE_THREADS
+#define TRACE_THREADS 0
+#endif
+#define TRACE_WINDOW 32
+#define TRACE_SHORTCUT_LENGTH 24
+#ifndef TRACE_EDIT_TRIES
+#define TRACE_EDIT_TRIES 1
+#endif
+
+// Beam widths tried one after another by an anytime solve while its time limit isn't reached
+#ifndef ANYTIME_FIRST_WIDTH
+#define ANYTIME_FIRST_WIDTH 10
+#endif
+#ifndef ANYTIME_MAX_WIDTH
+#define ANYTIME_MAX_WIDTH 40960
+#endif
+
 #define MOVE_COST -1
 #define LAMBDA_COST 25
 #define ABORT_COST 25